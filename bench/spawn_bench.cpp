@@ -0,0 +1,104 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 19:26:40
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 19:26:40
+ * @FilePath: /WebServerByCPP/bench/spawn_bench.cpp
+ * @Description: CGI进程启动方式的微基准: 比较fork()+execve()与posix_spawn()在不同进程内存大小下的开销
+ * 先分配并写满指定大小的内存(关闭透明大页, 按4K页建立页表, 接近长期运行的服务器堆), 再反复启动/bin/true并等待其退出
+ * fork需要复制整个地址空间的页表, 开销随内存增长; posix_spawn以vfork语义共享地址空间直到exec, 开销基本不变
+ * 用法: spawn_bench [次数] [内存大小MB...], 默认200次, 内存大小0 256 1024
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+static const char *PROGRAM = "/bin/true";
+
+// 以fork+execve启动一次并等待退出
+static void forkOnce()
+{
+    char *argv[] = {const_cast<char *>(PROGRAM), nullptr};
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        execve(PROGRAM, argv, environ);
+        _exit(127);
+    }
+    if (pid > 0)
+        waitpid(pid, nullptr, 0);
+}
+
+// 以posix_spawn启动一次并等待退出
+static void spawnOnce()
+{
+    char *argv[] = {const_cast<char *>(PROGRAM), nullptr};
+    pid_t pid;
+    if (posix_spawn(&pid, PROGRAM, nullptr, nullptr, argv, environ) == 0)
+        waitpid(pid, nullptr, 0);
+}
+
+// 平均每次启动的耗时(微秒)
+template <typename Launch>
+static double measure(Launch launch, int iterations)
+{
+    launch(); // 预热
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        launch();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    if (iterations < 1)
+        iterations = 1;
+
+    std::vector<size_t> sizes;
+    for (int i = 2; i < argc; ++i)
+    {
+        sizes.push_back(static_cast<size_t>(atol(argv[i])));
+    }
+    if (sizes.empty())
+        sizes = {0, 256, 1024};
+
+    printf("启动 %s %d 次, 每次等待退出, 单位: 微秒/次\n", PROGRAM, iterations);
+    printf("%10s %14s %14s %8s\n", "mem(MB)", "fork+execve", "posix_spawn", "ratio");
+
+    for (size_t size_mb : sizes)
+    {
+        const size_t bytes = size_mb << 20;
+        void *memory = nullptr;
+        if (bytes > 0)
+        {
+            memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+            {
+                perror("mmap");
+                return 1;
+            }
+            madvise(memory, bytes, MADV_NOHUGEPAGE);
+            memset(memory, 1, bytes);
+        }
+
+        double fork_us = measure(forkOnce, iterations);
+        double spawn_us = measure(spawnOnce, iterations);
+        printf("%10zu %14.1f %14.1f %8.2f\n", size_mb, fork_us, spawn_us, fork_us / spawn_us);
+
+        if (memory != nullptr)
+            munmap(memory, bytes);
+    }
+    return 0;
+}
\ No newline at end of file
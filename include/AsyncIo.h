@@ -0,0 +1,139 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 15:14:40
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 15:14:40
+ * @FilePath: /WebServerByCPP/include/AsyncIo.h
+ * @Description: 协程中使用的异步IO操作, 基于EventLoop的fd就绪事件和定时器
+ * 读写先直接尝试非阻塞系统调用, 返回EAGAIN时才在事件循环上临时注册fd并挂起, 就绪后移除注册并恢复协程
+ * 带期限的等待同时注册fd和定时器, 先发生的一方移除另一方后恢复协程, 用于限制等待外部进程的时间
+ * 所有操作只能在协程所在EventLoop的线程中使用, fd必须是非阻塞的
+ */
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include "Task.h"
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <sys/types.h>
+
+// 前向声明
+class EventLoop;
+
+// 挂起直到fd就绪, 结果为就绪的事件掩码
+class FdAwaiter
+{
+  private:
+    EventLoop &loop;
+    int fd;
+    uint32_t events;       // 等待的事件(EPOLLIN或EPOLLOUT)
+    uint32_t ready_events; // 就绪时收到的事件
+
+  public:
+    FdAwaiter(EventLoop &loop, int fd, uint32_t events) : loop(loop), fd(fd), events(events), ready_events(0)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> waiter);
+
+    uint32_t await_resume() const noexcept
+    {
+        return ready_events;
+    }
+};
+
+// 挂起直到fd就绪或期限到达, 结果为就绪的事件掩码, 期限到达时为0
+class TimedFdAwaiter
+{
+  private:
+    EventLoop &loop;
+    int fd;
+    uint32_t events;       // 等待的事件(EPOLLIN或EPOLLOUT)
+    uint32_t ready_events; // 就绪时收到的事件
+    int64_t timeout_ms;    // 距期限的毫秒数, 小于0表示没有期限
+    uint64_t timer;        // 期限定时器, 0表示没有
+
+  public:
+    TimedFdAwaiter(EventLoop &loop, int fd, uint32_t events, std::chrono::steady_clock::time_point deadline);
+
+    // 期限已过时不挂起
+    bool await_ready() const noexcept
+    {
+        return timeout_ms == 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> waiter);
+
+    uint32_t await_resume() const noexcept
+    {
+        return ready_events;
+    }
+};
+
+// 挂起指定的毫秒数
+class SleepAwaiter
+{
+  private:
+    EventLoop &loop;
+    int64_t milliseconds;
+
+  public:
+    SleepAwaiter(EventLoop &loop, int64_t milliseconds) : loop(loop), milliseconds(milliseconds)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return milliseconds <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> waiter);
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+// 等待fd可读/可写
+inline FdAwaiter waitReadable(EventLoop &loop, int fd)
+{
+    return FdAwaiter(loop, fd, EPOLLIN);
+}
+
+inline FdAwaiter waitWritable(EventLoop &loop, int fd)
+{
+    return FdAwaiter(loop, fd, EPOLLOUT);
+}
+
+// 等待fd可读/可写, 最迟到deadline; deadline为time_point::max()时没有期限
+inline TimedFdAwaiter waitReadableUntil(EventLoop &loop, int fd, std::chrono::steady_clock::time_point deadline)
+{
+    return TimedFdAwaiter(loop, fd, EPOLLIN, deadline);
+}
+
+inline TimedFdAwaiter waitWritableUntil(EventLoop &loop, int fd, std::chrono::steady_clock::time_point deadline)
+{
+    return TimedFdAwaiter(loop, fd, EPOLLOUT, deadline);
+}
+
+// 等待一段时间, 不占用线程
+inline SleepAwaiter sleepFor(EventLoop &loop, int64_t milliseconds)
+{
+    return SleepAwaiter(loop, milliseconds);
+}
+
+// 读取至多len字节, 没有数据时挂起; 返回读到的字节数, 0表示对端关闭, 出错时返回-errno
+Task<ssize_t> asyncRead(EventLoop &loop, int fd, void *buf, size_t len);
+
+// 写出全部len字节, 缓冲区满时挂起; 返回写出的字节数, 出错时返回-errno
+Task<ssize_t> asyncWrite(EventLoop &loop, int fd, const void *data, size_t len);
+
+#endif // ASYNC_IO_H
\ No newline at end of file
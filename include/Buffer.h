@@ -0,0 +1,105 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 13:20:08
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 13:20:08
+ * @FilePath: /WebServerByCPP/include/Buffer.h
+ * @Description: 连接读写缓冲区, 底层为连续的vector<char>, 用读/写两个下标划分出可读区和可写区
+ * readFd使用readv配合栈上的额外空间, 一次系统调用即可读入大块数据而不必预先分配大缓冲区
+ * 取走数据只移动读下标, 剩余字节(如请求体、流水线中的下一个请求)保留在缓冲区中供后续处理
+ * 可写空间不足时优先把可读数据搬到头部复用已读空间, 仍不足才扩容
+ */
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+class Buffer
+{
+  private:
+    std::vector<char> buffer; // 底层存储
+    size_t reader_index;      // 可读区起始位置
+    size_t writer_index;      // 可写区起始位置
+
+    static constexpr size_t INITIAL_SIZE = 4096;     // 初始容量
+    static constexpr size_t EXTRA_READ_SIZE = 65536; // readFd在栈上使用的额外空间
+
+    char *begin()
+    {
+        return buffer.data();
+    }
+    const char *begin() const
+    {
+        return buffer.data();
+    }
+
+    // 保证至少有len字节的可写空间
+    void makeSpace(size_t len);
+
+  public:
+    explicit Buffer(size_t initial_size = INITIAL_SIZE);
+
+    // 可读字节数
+    size_t readableBytes() const
+    {
+        return writer_index - reader_index;
+    }
+
+    // 可写字节数
+    size_t writableBytes() const
+    {
+        return buffer.size() - writer_index;
+    }
+
+    // 可读数据起始地址
+    const char *peek() const
+    {
+        return begin() + reader_index;
+    }
+
+    // 可写区起始地址
+    char *beginWrite()
+    {
+        return begin() + writer_index;
+    }
+
+    // 从start开始查找换行符'\n', 未找到返回nullptr
+    const char *findEOL(const char *start) const;
+
+    // 取走len字节(只移动读下标)
+    void retrieve(size_t len);
+
+    // 取走全部数据
+    void retrieveAll();
+
+    // 只保留前len字节可读数据, 丢弃之后追加的内容
+    void truncate(size_t len)
+    {
+        if (len < readableBytes())
+            writer_index = reader_index + len;
+    }
+
+    // 取走len字节并返回其拷贝
+    std::string retrieveAsString(size_t len);
+
+    // 追加数据
+    void append(const char *data, size_t len);
+    void append(const std::string &data)
+    {
+        append(data.data(), data.size());
+    }
+
+    // 从fd读取数据, 返回读取的字节数, 出错时返回-1并设置saved_errno
+    ssize_t readFd(int fd, int *saved_errno);
+
+    // 下一次readFd最多能读取的字节数, 读到的数据少于它说明内核缓冲区已读空
+    size_t readCapacity() const
+    {
+        return writableBytes() < EXTRA_READ_SIZE ? writableBytes() + EXTRA_READ_SIZE : writableBytes();
+    }
+};
+
+#endif // BUFFER_H
\ No newline at end of file
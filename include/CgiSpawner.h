@@ -0,0 +1,67 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 18:32:05
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 18:32:05
+ * @FilePath: /WebServerByCPP/include/CgiSpawner.h
+ * @Description: CGI辅助进程, 在服务器创建线程之前fork出来, 此时进程的地址空间还很小
+ * 服务器通过Unix域socket(SOCK_SEQPACKET)发送脚本路径和CGI环境变量, 管道的两端以SCM_RIGHTS随消息传递
+ * 辅助进程为每个脚本预先fork若干个等待中的子进程, 请求到达时交给其中一个, 子进程设置标准输入/输出和环境变量后exec脚本
+ * 这样请求处理中不再fork整个多线程的服务器进程, 启动CGI只需要一次消息发送; 补充子进程在交出请求之后进行
+ * 脚本不是服务器的子进程, 子进程在exec之前通过随请求传来的socket把自己的pid和pidfd交给服务器, 服务器用它们终止超时的脚本
+ * exec失败时子进程在同一个socket上发送失败消息后退出, 服务器据此返回500
+ * 服务器退出时socket关闭, 辅助进程和所有等待中的子进程随之退出; 辅助进程不可用时由调用者退回直接fork
+ */
+#ifndef CGI_SPAWNER_H
+#define CGI_SPAWNER_H
+
+#include <atomic>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+class CgiSpawner
+{
+  private:
+    // 服务器一端的socket, 未启动时为-1
+    static int server_socket;
+
+    // 发送失败(辅助进程已退出)后不再使用
+    static std::atomic<bool> available;
+
+    // 辅助进程的主循环, 不返回
+    [[noreturn]] static void run(int socket, int warm_per_script);
+
+  public:
+    // 脚本的启动状态, 由receiveReport根据子进程发回的报告得出
+    enum class Launch
+    {
+        Pending, // 尚未收到报告, 子进程还没有取得请求
+        Started, // 子进程已发回报告, 即将或已经exec脚本
+        Failed   // exec失败, 或辅助进程没能把请求交给子进程
+    };
+
+    // 启动辅助进程, 必须在创建任何线程之前调用; warm_per_script为每个脚本预先fork的子进程数
+    // 失败时返回false, 之后的CGI请求直接fork
+    static bool start(int warm_per_script);
+
+    // 辅助进程是否可用, 不可用时调用者不必准备spawn的参数
+    static bool isAvailable()
+    {
+        return available.load(std::memory_order_relaxed);
+    }
+
+    // 请求辅助进程以stdin_fd/stdout_fd为标准输入/输出运行脚本, env为脚本的完整环境, 每项为"名称=值"
+    // report_fd为SOCK_SEQPACKET socket的一端, 脚本进程exec之前从这里发回自己的pid和pidfd, exec失败时再发送失败消息
+    // 由receiveReport读取
+    // 不阻塞; 返回false时调用者应自己创建进程, 返回true后调用者可以关闭这三个fd
+    static bool spawn(const std::string &path, const std::vector<std::string> &env, int stdin_fd, int stdout_fd,
+                      int report_fd);
+
+    // 从spawn所用socket的另一端读取已到达的全部报告, 不阻塞, 返回脚本的启动状态; 可以多次调用直到不再是Pending
+    // 收到报告时脚本进程的pid存入pid(此前为-1表示还没有收到过), pidfd(带close-on-exec)存入pid_fd
+    // 内核不支持pidfd时报告中没有pidfd, pid_fd保持-1; 对端关闭而从未收到报告时为Failed
+    static Launch receiveReport(int socket, pid_t &pid, int &pid_fd);
+};
+
+#endif // CGI_SPAWNER_H
\ No newline at end of file
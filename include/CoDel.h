@@ -0,0 +1,52 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 16:48:05
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 16:48:05
+ * @FilePath: /WebServerByCPP/include/CoDel.h
+ * @Description: CoDel(Controlled Delay)队列管理, 按任务的排队时间决定是否丢弃, 用于请求通道的过载保护
+ * 排队时间持续一个间隔都高于目标值时认为队列中有积压(standing queue), 进入丢弃状态,
+ * 之后按 间隔/sqrt(丢弃次数) 的节奏丢弃, 直到排队时间回落到目标值以下; 短暂的突发不会触发丢弃
+ * 丢弃决定在任务出队(开始执行)时作出, 被丢弃的请求直接返回503, 释放出的处理能力留给排队时间短的请求
+ * 可由多个工作线程同时调用: 排队时间正常且未进入丢弃状态时只读一个原子标志, 其余情况在互斥锁内按原算法计算
+ */
+#ifndef CODEL_H
+#define CODEL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+class CoDel
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+  private:
+    Clock::duration target;   // 可接受的排队时间
+    Clock::duration interval; // 观察窗口, 排队时间在整个窗口内高于目标值才开始丢弃
+
+    std::mutex mutex;
+    std::atomic<bool> engaged;        // 排队时间已超过目标值或处于丢弃状态, 需要进入慢路径
+    bool dropping;                    // 是否处于丢弃状态
+    Clock::time_point first_above;    // 排队时间超过目标值后, 允许开始丢弃的时间; 未超过时为默认值
+    Clock::time_point drop_next;      // 丢弃状态下下一次丢弃的时间
+    uint32_t count;                   // 本次丢弃状态中的丢弃次数
+    uint32_t last_count;              // 上一次丢弃状态结束时的丢弃次数
+
+    // 控制律: 丢弃间隔随丢弃次数的平方根缩短
+    Clock::time_point controlLaw(Clock::time_point t) const;
+
+    // 阻止复制
+    CoDel(const CoDel &) = delete;
+    CoDel &operator=(const CoDel &) = delete;
+
+  public:
+    CoDel(Clock::duration target, Clock::duration interval);
+
+    // 一个排队了sojourn时间的任务即将开始执行, 返回true表示应丢弃它
+    bool shouldDrop(Clock::duration sojourn, Clock::time_point now);
+};
+
+#endif // CODEL_H
\ No newline at end of file
@@ -0,0 +1,166 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 09:12:40
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 09:12:40
+ * @FilePath: /WebServerByCPP/include/EventLoop.h
+ * @Description: 基于epoll的事件循环(Reactor), 每个IO线程拥有一个EventLoop
+ * 采用边缘触发(EPOLLET)模式监听非阻塞fd的读写就绪事件, 并分发给注册的回调函数
+ * 可选io_uring后端: 就绪事件由多次poll请求产生, 注册/移除fd只是排入提交队列, 每轮循环用一次io_uring_enter批量提交并等待;
+ * 注册时提供数据回调的fd由多次recv把数据直接交付到回调(缓冲区来自内核共享的缓冲区环), 监听socket由多次accept直接交付新连接
+ * 通过eventfd实现跨线程唤醒, 其他线程可以使用runInLoop/queueInLoop把任务投递到循环线程执行
+ * 投递的任务(例如accept线程交给IO线程的新连接、工作线程处理完成的通知)进入无锁MPMC队列, 队列满时才暂存到加锁的溢出列表
+ * 同一个fd的所有回调都只在所属循环线程中执行, 因此连接状态无需加锁
+ * 内置分层时间轮定时器, 由timerfd按固定间隔推进(没有定时器时停止), 用于连接的各种超时
+ */
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include "MpmcQueue.h"
+#include "TimerWheel.h"
+#include <memory>
+#include <mutex>
+#include <sys/types.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 前向声明
+class IoUring;
+struct io_uring_cqe;
+
+class EventLoop
+{
+  public:
+    using EventCallback = std::function<void(uint32_t events)>; // fd就绪回调, 参数为epoll事件掩码
+    using DataCallback = std::function<void(const char *data, ssize_t len)>; // 收到的数据, len为0表示对端关闭, 小于0为-errno
+    using AcceptCallback = std::function<void(int client_socket)>;         // 新接受的连接(非阻塞)
+    using Functor = std::function<void()>;                      // 投递到循环线程执行的任务
+    using TimerId = TimerWheel::TimerId;                        // 定时器标识, 0表示无效
+    using Clock = std::chrono::steady_clock;
+
+    // IO多路复用后端
+    enum class Backend
+    {
+        EPOLL,   // epoll边缘触发, 读写由调用者自行完成
+        IO_URING // io_uring多次poll/recv/accept, 批量提交
+    };
+
+  private:
+    // 一个fd的注册信息
+    struct Registration
+    {
+        EventCallback on_event;   // 就绪回调
+        DataCallback on_data;     // 数据回调, 仅io_uring后端使用
+        AcceptCallback on_accept; // 新连接回调, 仅io_uring后端使用
+        uint32_t poll_events;     // poll请求监听的事件
+        uint32_t poll_token;      // 当前poll请求的标识, 0表示没有
+        uint32_t io_token;        // 当前recv/accept请求的标识, 0表示没有
+    };
+
+    int epoll_fd;                            // epoll实例, 使用io_uring后端时为-1
+    std::unique_ptr<IoUring> ring;           // io_uring实例, 使用epoll后端时为空
+    uint32_t next_token;                     // 分配请求标识, 用于丢弃已移除fd的过期完成事件
+    bool recv_buffers_failed;                // 接收缓冲区环注册失败, 退回为就绪事件+readv
+    int wakeup_fd;                           // 用于跨线程唤醒的eventfd
+    std::atomic<bool> quitting;              // 退出标志
+    std::atomic<std::thread::id> thread_id;  // 运行loop()的线程
+    std::atomic<bool> calling_pending_functors; // 是否正在执行投递的任务
+
+    MpmcQueue<Functor> pending_queue;      // 投递的任务, 无锁入队
+    std::vector<Functor> running_functors; // 本轮取出待执行的任务, 复用其容量
+    std::mutex mutex;                      // 保护pending_functors
+    std::vector<Functor> pending_functors; // pending_queue已满时暂存的任务
+    std::atomic<size_t> overflow_count;    // pending_functors中的任务数, 非零时新任务也进入溢出列表以保持顺序
+
+    std::unordered_map<int, Registration> registrations; // fd -> 注册信息
+    std::vector<Registration> dead_registrations;        // 本轮事件处理中被移除的回调, 延迟析构
+
+    // 定时器: 时间轮的tick由timerfd周期性推进, 只在有定时器时运行
+    int timer_fd;
+    bool timer_running;            // timerfd是否处于周期触发状态
+    Clock::time_point timer_epoch; // tick 0对应的时间
+    TimerWheel timer_wheel;
+
+    static constexpr int MAX_EVENTS = 1024;   // 单次epoll_wait最多返回的事件数
+    static constexpr int64_t TIMER_TICK_MS = 100; // 时间轮的tick长度(毫秒)
+    static constexpr unsigned URING_ENTRIES = 1024;     // io_uring提交队列长度
+    static constexpr unsigned RECV_BUFFER_COUNT = 256;  // 接收缓冲区个数
+    static constexpr unsigned RECV_BUFFER_SIZE = 8192;  // 每个接收缓冲区的字节数
+    static constexpr int64_t ACCEPT_RETRY_MS = 100;     // accept出错(如fd耗尽)后重新提交的间隔
+    static constexpr size_t PENDING_QUEUE_SIZE = 4096;  // 投递任务队列容量
+    static constexpr size_t PENDING_BATCH = 64;         // 每次从投递队列批量取出的任务数
+
+    void wakeup();            // 唤醒阻塞在epoll_wait上的循环
+    void handleWakeup();      // 读取eventfd计数
+    void doPendingFunctors(); // 执行其他线程投递的任务
+    void releaseDeadCallbacks(); // 析构延迟释放的回调
+    void runEpoll();             // epoll后端的事件循环
+    void runUring();             // io_uring后端的事件循环
+    void handleTimers();         // 推进时间轮, 执行所有到期的定时器
+    void setTimerRunning(bool running); // 启动或停止timerfd的周期触发
+    uint64_t nowTick() const;    // 当前时间对应的tick
+
+    // io_uring后端: 提交请求和处理完成事件
+    uint32_t nextToken();
+    void armPoll(int fd, uint32_t events, uint32_t token);
+    void armRecv(int fd, uint32_t token);
+    void armAccept(int fd, uint32_t token);
+    void cancelRequest(uint64_t user_data);
+    bool ensureRecvBuffers(); // 首次需要时注册接收缓冲区环
+    void handleCompletion(const struct io_uring_cqe &cqe);
+
+    // 阻止复制
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+  public:
+    // 指定io_uring后端但内核不支持时退回epoll
+    explicit EventLoop(Backend backend = Backend::EPOLL);
+    ~EventLoop();
+
+    // 实际使用的后端
+    Backend getBackend() const
+    {
+        return ring ? Backend::IO_URING : Backend::EPOLL;
+    }
+
+    // 运行事件循环, 阻塞直到quit()被调用
+    void loop();
+
+    // 退出事件循环, 可在任意线程(包括信号处理函数)中调用
+    void quit();
+
+    // 在循环线程中执行任务: 若当前就在循环线程则立即执行, 否则排队
+    void runInLoop(Functor cb);
+
+    // 把任务排入队列, 在本轮事件处理之后执行
+    void queueInLoop(Functor cb);
+
+    // 判断调用者是否处于循环线程
+    bool isInLoopThread() const
+    {
+        return thread_id == std::this_thread::get_id();
+    }
+
+    // 注册/修改/移除fd, 只能在循环线程中调用
+    // 提供on_data且使用io_uring后端时, 读取由循环完成, 数据通过on_data交付, cb不再收到读就绪事件
+    void addFd(int fd, uint32_t events, EventCallback cb, DataCallback on_data = DataCallback());
+
+    // 注册监听socket: io_uring后端由多次accept把新连接交给on_accept, epoll后端在就绪时调用cb
+    void addListener(int fd, uint32_t events, EventCallback cb, AcceptCallback on_accept);
+    void modFd(int fd, uint32_t events);
+    void removeFd(int fd);
+
+    // 在milliseconds毫秒后执行一次cb, 只能在循环线程中调用
+    TimerId runAfter(int64_t milliseconds, Functor cb);
+
+    // 取消尚未到期的定时器, 只能在循环线程中调用
+    void cancelTimer(TimerId id);
+};
+
+#endif // EVENT_LOOP_H
\ No newline at end of file
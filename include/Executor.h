@@ -0,0 +1,103 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 15:31:52
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 15:31:52
+ * @FilePath: /WebServerByCPP/include/Executor.h
+ * @Description: 协程执行器, 由少量线程各运行一个EventLoop, 协程任务在其中执行, 等待IO时挂起而不占用线程
+ * 同时运行的任务数有上限, 超出的任务进入有界等待队列, 队列已满时trySpawn返回false, 由调用者决定如何拒绝
+ * 新任务轮流分配给各事件循环, 一个任务从开始到结束都在同一个循环线程中执行
+ * 停止时各循环直接退出, 仍挂起的任务不再恢复
+ */
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "EventLoop.h"
+#include "Task.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Executor
+{
+  public:
+    using TaskFactory = std::function<Task<void>(EventLoop &loop)>; // 在分配到的循环线程中创建任务
+
+  private:
+    std::vector<std::unique_ptr<EventLoop>> loops; // 每个线程一个事件循环
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_loop;                 // 轮流分配任务的下标
+    size_t max_active;                             // 同时运行的任务数上限
+    size_t max_queue;                              // 等待队列长度
+
+    std::mutex mutex;                  // 保护pending和active
+    std::deque<TaskFactory> pending;   // 等待运行的任务
+    size_t active;                     // 正在运行的任务数
+
+    // 统计, 供状态页读取
+    std::atomic<size_t> active_count;
+    std::atomic<size_t> queued_count;
+    std::atomic<uint64_t> completed_count;
+    std::atomic<uint64_t> rejected_count;
+    std::atomic<bool> stopping;
+
+    // 把任务交给下一个事件循环执行
+    void launch(TaskFactory factory);
+
+    // 执行任务, 结束后开始等待队列中的下一个
+    Task<void> run(EventLoop &loop, TaskFactory factory);
+    void finish();
+
+    // 阻止复制
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+
+  public:
+    Executor(size_t thread_count, size_t max_active, size_t max_queue,
+             EventLoop::Backend backend = EventLoop::Backend::EPOLL);
+    ~Executor();
+
+    // 启动所有循环线程
+    void start();
+
+    // 退出所有循环并等待线程结束
+    void stop();
+
+    // 提交任务, 运行数已达上限且等待队列已满或执行器已停止时返回false
+    bool trySpawn(TaskFactory factory);
+
+    size_t threadCount() const
+    {
+        return loops.size();
+    }
+
+    // 正在运行(包括挂起等待IO)的任务数
+    size_t activeCount() const
+    {
+        return active_count.load(std::memory_order_relaxed);
+    }
+
+    // 等待运行的任务数
+    size_t queueSize() const
+    {
+        return queued_count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t completedCount() const
+    {
+        return completed_count.load(std::memory_order_relaxed);
+    }
+
+    uint64_t rejectedCount() const
+    {
+        return rejected_count.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // EXECUTOR_H
\ No newline at end of file
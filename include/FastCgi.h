@@ -0,0 +1,99 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 17:31:46
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 17:31:46
+ * @FilePath: /WebServerByCPP/include/FastCgi.h
+ * @Description: FastCGI客户端, 把动态请求转发给常驻的FastCGI应用服务器(例如php-fpm), 不再为每个请求创建进程
+ * 后端地址可以是Unix域socket路径或host:port; 路由表按URL路径前缀或扩展名把请求映射到后端
+ * 每个执行器线程对每个后端维护一个连接池, 连接建立后以FCGI_KEEP_CONN长期复用, 空闲时由后端关闭也会自动重连
+ * 一个连接上可以同时进行多个请求(按请求ID复用), 后端不支持复用时把每个连接的请求数设为1
+ * 请求在协程中执行: 取得连接、发送记录、等待响应时都挂起, 只在所属执行器线程上运行, 连接池不需要加锁
+ */
+#ifndef FAST_CGI_H
+#define FAST_CGI_H
+
+#include "Task.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 前向声明
+class EventLoop;
+
+// 一个FastCGI后端及其连接池参数
+struct FastCgiBackend
+{
+    std::string address;            // 配置中的原始地址, 用于日志
+    bool unix_socket;               // 是否为Unix域socket
+    std::string unix_path;          // Unix域socket路径
+    std::string host;               // TCP地址
+    uint16_t port;                  // TCP端口
+    size_t max_connections;         // 每个执行器线程到该后端的最大连接数
+    size_t max_requests_per_conn;   // 一个连接上同时进行的最大请求数, 1表示不复用
+    int timeout_ms;                 // 请求的时限(毫秒), 包括建立连接、等待空闲连接和等待响应; 超时返回504
+    size_t max_output;              // 应用输出的最大字节数, 超出时返回502并关闭连接; 0表示不限制
+};
+
+// URL到后端的路由表, 启动时由配置生成, 之后只读
+class FastCgiRoutes
+{
+  private:
+    struct Route
+    {
+        std::string pattern;            // 以'.'开头时为扩展名, 否则为路径前缀
+        const FastCgiBackend *backend;
+    };
+
+    std::vector<std::unique_ptr<FastCgiBackend>> backends; // 地址相同的路由共用一个后端
+    std::vector<Route> routes;                            // 按配置顺序匹配
+
+  public:
+    // 解析"模式 地址"的列表, 以逗号分隔, 例如".php /run/php-fpm.sock, /api/ 127.0.0.1:9000";
+    // 模式以'.'开头时按扩展名匹配, 否则按路径前缀匹配; 格式错误时抛出异常
+    static std::unique_ptr<FastCgiRoutes> parse(const std::string &spec, const FastCgiBackend &defaults);
+
+    // 按脚本路径(URL解码后的路径, 以'/'开头)查找后端, 没有匹配时返回nullptr
+    const FastCgiBackend *match(std::string_view script_name) const;
+
+    bool empty() const
+    {
+        return routes.empty();
+    }
+
+    // 路由说明, 用于启动日志
+    std::string describe() const;
+};
+
+// 按FastCGI的名称-值格式编码参数
+class FastCgiParams
+{
+  private:
+    std::string encoded;
+
+    void appendLength(size_t length);
+
+  public:
+    void add(std::string_view name, std::string_view value);
+
+    const std::string &data() const
+    {
+        return encoded;
+    }
+};
+
+// 一次FastCGI请求的结果
+struct FastCgiResult
+{
+    int error_status;   // 0表示成功, 否则为应返回给客户端的状态码(502/504)
+    std::string output; // 应用的标准输出, 格式与CGI输出相同
+};
+
+// 在loop所在的执行器线程中把请求发送给backend并等待完整的输出
+Task<FastCgiResult> fastCgiRequest(EventLoop &loop, const FastCgiBackend &backend, const FastCgiParams &params,
+                                   std::string_view body);
+
+#endif // FAST_CGI_H
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 16:05:21
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 16:05:21
+ * @FilePath: /WebServerByCPP/include/FileCache.h
+ * @Description: 热点静态文件缓存, 按总字节数限制容量, 超出时淘汰最久未使用的文件
+ * 缓存项保存文件内容和预先生成的响应头(保持连接/关闭连接两种), 命中时不再stat/open/read文件
+ * 由所有工作线程共享, 缓存项以shared_ptr返回, 淘汰或失效后正在发送的请求仍可安全使用
+ * 使用inotify监视文档根目录(含子目录), 文件被修改、删除或移动时使对应缓存项失效
+ */
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class FileCache
+{
+  public:
+    // 缓存项, 创建后不再修改
+    struct Entry
+    {
+        std::string content;         // 文件内容
+        std::string head_keep_alive; // 带Connection: keep-alive的完整响应头
+        std::string head_close;      // 带Connection: close的完整响应头
+
+        size_t size() const
+        {
+            return content.size() + head_keep_alive.size() + head_close.size();
+        }
+    };
+
+  private:
+    struct Slot
+    {
+        std::shared_ptr<const Entry> entry;
+        std::list<std::string>::iterator lru_position; // 在lru_list中的位置
+    };
+
+    size_t capacity;      // 缓存总字节数上限
+    size_t max_file_size; // 可缓存的单个文件最大字节数
+
+    mutable std::mutex mutex;                     // 保护以下成员
+    std::list<std::string> lru_list;              // 最近使用的路径在前
+    std::unordered_map<std::string, Slot> slots;  // 路径到缓存项
+    size_t used_bytes;                            // 已使用的字节数
+    uint64_t generation;                          // 每次失效递增, 防止加载期间失效的文件被放入缓存
+
+    int inotify_fd;                                  // inotify实例, 未启用时为-1
+    std::unordered_map<int, std::string> watch_dirs; // 监视描述符到目录路径
+    std::string watch_root;                          // 被监视的文档根目录, 与请求路径的前缀相同
+    std::string real_root;                           // 文档根目录解析符号链接后的真实路径, 未开始监视时为空
+
+    // 监视目录及其所有子目录
+    void watchDirectory(const std::string &dir);
+
+    // 以下方法调用时必须持有mutex
+    void eraseLocked(const std::string &path);
+    void evictLocked();
+
+    // 路径中包含"//"或"/./"时同一文件可能对应多个键, 无法准确失效, 不缓存
+    static bool isCacheablePath(const std::string &path);
+
+    // 路径是否位于被监视的目录中且不经过符号链接; 符号链接指向的目录不被监视(同一目录只能有一个监视描述符),
+    // 经由符号链接访问的文件修改后收不到对应路径的事件, 不缓存
+    bool isWatchedPath(const std::string &path) const;
+
+    // 阻止复制
+    FileCache(const FileCache &) = delete;
+    FileCache &operator=(const FileCache &) = delete;
+
+  public:
+    FileCache(size_t capacity, size_t max_file_size);
+    ~FileCache();
+
+    // 查找缓存项并标记为最近使用, 未命中返回nullptr
+    std::shared_ptr<const Entry> get(const std::string &path);
+
+    // 文件是否已缓存(不改变淘汰顺序), 用于跳过请求解析时的stat
+    bool contains(const std::string &path) const;
+
+    // 读取文件并放入缓存, 文件不存在、不是普通文件、可执行、过大或不在被监视的目录中时返回nullptr
+    std::shared_ptr<const Entry> load(const std::string &path);
+
+    // 使单个文件或全部缓存失效
+    void invalidate(const std::string &path);
+    void clear();
+
+    // 开始监视文档根目录, 失败时返回false; 开始监视之前不缓存任何文件
+    bool startWatching(const std::string &root);
+
+    // inotify描述符, 可读时调用handleWatchEvents
+    int getWatchFd() const
+    {
+        return inotify_fd;
+    }
+
+    // 读取全部inotify事件并使相关缓存项失效
+    void handleWatchEvents();
+};
+
+#endif // FILE_CACHE_H
\ No newline at end of file
@@ -0,0 +1,186 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 09:41:27
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 09:41:27
+ * @FilePath: /WebServerByCPP/include/HttpConnection.h
+ * @Description: HTTP连接类, 表示一个由EventLoop驱动的非阻塞客户端连接
+ * 读就绪时以大块readv读空socket并累积到输入缓冲区, 每次把缓冲区交给可恢复的HttpRequest解析器增量解析
+ * 使用io_uring后端时由事件循环的多次recv直接交付数据, 追加到输入缓冲区后同样增量解析
+ * 解析结果以string_view指向输入缓冲区, 因此请求处理期间不再读取socket, 处理完毕后才取走请求数据
+ * 请求处理器按类型在静态文件通道(工作线程池)或CGI通道(协程执行器)中执行, 执行期间连接交由该线程独占,
+ * 完成后回到所属循环线程继续发送; CGI处理器作为协程在执行器的循环线程中运行, 等待管道时挂起
+ * 流水线中的后续请求属于另一个通道时交回循环线程重新投递, 慢速CGI不会占用静态文件通道的线程
+ * 处理器产生的响应先写入输出缓冲区, 由写就绪事件驱动发送, 不会阻塞IO线程
+ * 支持HTTP/1.1持久连接: 按协议版本和Connection头决定是否保持连接, 响应发送后回到解析状态等待下一个请求
+ * 每个连接的请求数有上限, 等待请求期间由事件循环的定时器控制空闲超时
+ * 连接对象由shared_ptr管理, 注册在EventLoop中的回调持有它, 从循环中移除后自动释放
+ */
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include "Buffer.h"
+#include "HttpRequest.h"
+#include "Task.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+// 前向声明
+class EventLoop;
+class HttpServer;
+
+class HttpConnection : public std::enable_shared_from_this<HttpConnection>
+{
+  private:
+    EventLoop *loop;        // 所属事件循环
+    int client_socket;      // 客户端socket(非阻塞)
+    HttpServer &server;     // 所属服务器, 用于读取配置参数
+    bool closed;            // 连接是否已关闭
+    bool handling;          // 请求是否正在工作线程中处理, 期间循环线程不访问输入/输出缓冲区
+    bool peer_closed;       // 对端是否已关闭写方向
+    bool read_pending;      // 处理期间或输出积压时收到读就绪事件, 之后再读取
+    bool keep_alive;        // 当前请求的响应发送后是否保持连接
+    bool close_after_write; // 输出缓冲区发送完毕后关闭连接, 之后收到的数据全部丢弃
+    bool output_blocked;    // 因输出缓冲区积压而暂停读取和解析流水线中的后续请求
+    bool input_overflow;    // 处理期间暂存的输入超过上限已被丢弃, 处理完成后发送完已有响应即关闭连接
+    bool cgi_lane;          // 正在处理的任务所在的通道是否为CGI通道
+    bool dispatch_pending;  // 已解析出属于另一个通道的请求, 回到循环线程后重新投递
+    std::chrono::steady_clock::time_point dispatch_time; // 最近一次投递到通道的时间, 用于准入控制
+    int request_count;      // 本连接已处理的请求数
+
+    // 连接当前所处阶段的期限
+    enum class Deadline
+    {
+        NONE,   // 请求正在处理, 不计时
+        IDLE,   // 等待下一个请求
+        HEADER, // 读取请求头
+        BODY,   // 读取请求体
+        WRITE   // 发送响应
+    };
+    Deadline deadline;        // 当前期限的类型
+    uint64_t deadline_timer;  // 期限定时器, 0表示没有
+    int deadline_request;     // 设置期限时的request_count, 用于区分流水线中的不同请求
+    bool write_progress;      // 上次设置期限后是否发送出了数据
+
+    // 输出队列中的一段数据: 内存数据或文件中的一段区域(由sendfile直接从页缓存发送)
+    struct OutputChunk
+    {
+        Buffer data;     // 内存数据, file_fd为-1时有效
+        int file_fd;     // 文件描述符, 由连接负责关闭
+        off_t offset;    // 文件中下一个待发送字节的偏移
+        size_t length;   // 文件中剩余待发送的字节数
+    };
+
+    Buffer input_buffer;                  // 已读取但尚未处理的数据
+    Buffer deferred_input;                // 请求处理期间由事件循环交付的数据, 处理完成后并入输入缓冲区
+    std::deque<OutputChunk> output_queue; // 等待发送的响应数据, 按顺序发送
+    size_t output_bytes;                  // 输出队列中待发送的总字节数
+    HttpRequest request;                  // 当前请求, 在连接上复用
+
+    // 从输入缓冲区取出一个请求的结果
+    enum class RequestStep
+    {
+        NEED_MORE, // 请求不完整
+        RESPONDED, // 已直接生成响应(错误响应等)
+        DISPATCH   // 请求完整, 需要交给请求处理器
+    };
+
+    static constexpr size_t OUTPUT_HIGH_WATER = 64 * 1024; // 输出积压超过该值时暂停读取和解析后续请求
+    static constexpr size_t MAX_PENDING_INPUT = 1024 * 1024; // 每轮最多读取的输入; 多次recv无法暂停, 也是处理期间或输出积压时最多暂存的输入
+
+    // 事件处理
+    void handleEvent(uint32_t events);
+    void handleRead(bool drain);
+    void handleData(const char *data, ssize_t len);
+    void handleWrite();
+    void handleClose();
+    void handleDeadline(Deadline expired);
+
+    // 增量解析请求, 请求完整后把处理器投递到工作线程池, 最后统一发送输出缓冲区
+    void processRequest();
+
+    // 解析输入缓冲区中的下一个请求, 可由循环线程或独占连接的工作线程调用, 不访问定时器
+    RequestStep takeRequest();
+
+    // 是否可以继续处理流水线中的下一个请求
+    bool canTakeRequest() const;
+
+    // 直接发送预先生成的错误响应并结束当前请求, keep为false时发送完毕后关闭连接
+    void respondError(int status_code, bool keep);
+
+    // 发送状态页并结束当前请求
+    void respondStatus(bool keep);
+
+    // 请求的响应已写入输出缓冲区, 取走请求数据并准备下一个请求
+    void finishRequest();
+
+    // 根据协议版本、Connection头和请求数上限决定是否保持连接
+    bool shouldKeepAlive() const;
+
+    // 根据连接当前的状态设置期限, 阶段未变化时保留原有期限
+    void updateDeadline();
+    void setDeadline(Deadline next);
+
+    // 对端已关闭且没有待处理的工作时关闭连接
+    void maybeClose();
+
+    // 丢弃输出队列中第mark字节之后的数据
+    void truncateOutput(size_t mark);
+
+    // 清空输出队列并关闭其中的文件
+    void clearOutput();
+
+    // 在工作线程中执行请求处理器, 并依次处理流水线中已完整到达的后续请求
+    void runHandler();
+
+    // 协程版本, 在执行器的循环线程中执行处理器的handleAsync
+    Task<void> runAsyncHandler(EventLoop &executor_loop);
+
+    // 投递的请求开始处理前的准入检查, 被拒绝时已写入503响应并返回false
+    bool admitDispatched();
+
+    // 取出流水线中属于当前通道的下一个请求; 没有可处理的请求或下一个请求属于另一个通道时返回NEED_MORE
+    RequestStep takeNextInLane();
+
+    // 工作线程处理完成后在循环线程中调用, 开始发送响应
+    void onRequestHandled();
+
+    // 阻止复制
+    HttpConnection(const HttpConnection &) = delete;
+    HttpConnection &operator=(const HttpConnection &) = delete;
+
+  public:
+    HttpConnection(EventLoop *loop, int client_socket, HttpServer &server);
+    ~HttpConnection();
+
+    // 注册到事件循环, 必须在所属循环线程中调用
+    void start();
+
+    // 追加响应数据到输出队列, 在处理器返回后统一发送
+    void send(const char *data, size_t len);
+    void send(const std::string &data);
+
+    // 把缓冲区中的数据整体移入输出队列, 不复制, 用于较大的响应体
+    void send(Buffer &&data);
+
+    // 追加文件中从offset开始的length字节到输出队列, 连接接管fd并在发送完毕或关闭时关闭它
+    void sendFile(int fd, off_t offset, size_t length);
+
+    // 当前响应是否保持连接, 用于生成Connection响应头
+    bool isKeepAlive() const
+    {
+        return keep_alive;
+    }
+
+    int getSocket() const
+    {
+        return client_socket;
+    }
+};
+
+#endif // HTTP_CONNECTION_H
\ No newline at end of file
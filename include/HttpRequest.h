@@ -2,95 +2,222 @@
  * @Author: No_World 2259881867@qq.com
  * @Date: 2025-05-15 08:54:57
  * @LastEditors: No_World 2259881867@qq.com
- * @LastEditTime: 2025-05-19 15:53:25
+ * @LastEditTime: 2026-10-16 14:40:12
  * @FilePath: \WebServerByCPP\include\HttpRequest.h
  * @Description: HTTP请求解析类，负责解析客户端发送的HTTP请求，提取请求方法、URL、路径、查询字符串
  * 和HTTP头信息。支持CGI请求识别，采用封装设计原则，提供安全访问内部数据的getter方法。
+ * 解析器是可恢复的状态机: 每次传入连接缓冲区中当前的全部数据, 数据不完整时返回NEED_MORE,
+ * 下次从上次停下的位置继续。URL、查询字符串、头部和请求体都以偏移量记录, 以string_view的形式
+ * 指向连接缓冲区, 典型请求的解析过程不分配内存; 对象可在同一连接上通过reset()复用。
  * 包含友元函数用于格式化输出请求信息，便于调试和日志记录。作为HTTP服务器的核心组件，
  * 为请求处理流程提供必要的数据结构和解析功能。
  */
 #ifndef HTTP_REQUEST_H
 #define HTTP_REQUEST_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
+
+// 前向声明
+class FileCache;
+class FastCgiRoutes;
+struct FastCgiBackend;
 
 class HttpRequest
 {
+  public:
+    // 解析结果
+    enum class ParseResult
+    {
+        NEED_MORE, // 数据不完整, 等待更多数据后再次调用parse
+        COMPLETE,  // 请求(含请求体)已完整
+        ERROR      // 请求格式错误, 错误信息见getErrorMessage()
+    };
+
   private:
-    std::string method;
-    std::string url;
-    std::string path;
-    std::string query_string;
-    std::map<std::string, std::string> headers;
+    // 解析状态
+    enum class ParseState
+    {
+        REQUEST_LINE,
+        HEADERS,
+        BODY,
+        COMPLETE,
+        ERROR
+    };
+
+    // 相对于请求起始位置的片段, 缓冲区搬移或扩容后依然有效
+    struct Token
+    {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    struct HeaderToken
+    {
+        Token name;
+        Token value;
+    };
+
+    static constexpr size_t MAX_HEADER_SIZE = 8192;          // 请求头最大长度
+    static constexpr size_t MAX_BODY_SIZE = 8 * 1024 * 1024; // 请求体最大长度
+    static constexpr size_t MAX_HEADERS = 64;                // 最多保存的头部数量
+
+    const char *base; // 最近一次parse传入的数据起始地址, 所有Token都相对于它
+
+    ParseState state;      // 当前解析状态
+    size_t scan_offset;    // 下一行的起始偏移
+    size_t header_length;  // 请求头长度(含结尾空行)
+    size_t content_length; // 请求体长度
+
+    std::string_view method; // 请求方法(统一为大写的字面量)
+    Token url;               // 请求路径(未解码, 不含查询字符串)
+    Token query_string;      // 查询字符串
+    Token version;           // 协议版本
+    std::array<HeaderToken, MAX_HEADERS> headers;
+    size_t header_count;
+
+    std::string path; // 文件路径, 复用时保留容量
     bool is_cgi;
+    bool is_status; // 是否为状态页请求, 不对应文件
+    const FastCgiBackend *fastcgi_backend; // 路由到的FastCGI后端, 为nullptr时不是FastCGI请求
+    size_t script_offset;                  // 脚本路径(以'/'开头)在path中的起始位置
     std::string error_message; // 存储错误信息
 
-    // 配置参数
-    std::string DOC_ROOT;
-    std::string DEFAULT_DOCUMENT;
+    // 配置参数, 指向服务器持有的字符串
+    std::string_view DOC_ROOT;
+    std::string_view DEFAULT_DOCUMENT;
+    std::string_view STATUS_PATH; // 状态页路径, 为空时不启用
+    FileCache *file_cache; // 静态文件缓存, 未启用时为nullptr
+    const FastCgiRoutes *fastcgi_routes; // FastCGI路由表, 未配置时为nullptr
+
+    std::string_view view(Token token) const
+    {
+        return std::string_view(base + token.offset, token.length);
+    }
+
+    // 解析请求行和头部行, 失败时设置错误信息
+    bool parseRequestLine(const char *line, size_t len);
+    bool parseHeaderLine(const char *line, size_t len);
 
-    static constexpr int MAX_LINE_LENGTH = 1024; // 定义最大行长度常量
+    // 请求头完整后检查请求体长度并解析文件路径
+    bool finishHeaders();
 
-    // 辅助函数
-    static size_t getLine(int sock, std::string &buf);
+    // 设置错误状态
+    ParseResult fail(const char *message);
 
     // 检查文件访问权限
     bool checkFileAccess();
 
-    // url解析函数
-    static std::string urlDecode(const std::string &encoded);
+    // url解码函数, 解码结果追加到out
+    static void urlDecode(std::string_view encoded, std::string &out);
 
   public:
-    // 带配置参数的构造函数
-    HttpRequest(const std::string &root = "httpdocs", const std::string &default_doc = "test.html");
+    // 带配置参数的构造函数, 参数字符串和缓存必须比请求对象存活更久
+    HttpRequest(std::string_view root = "httpdocs", std::string_view default_doc = "test.html",
+                FileCache *cache = nullptr, std::string_view status_path = std::string_view(),
+                const FastCgiRoutes *routes = nullptr);
+
+    // 解析HTTP请求, data指向连接缓冲区中当前请求的起始位置, len为已收到的字节数
+    // 每次调用都应传入从请求起始位置开始的全部数据, 解析从上次停下的位置继续
+    // 返回COMPLETE后, 在请求处理完毕之前缓冲区中的这部分数据不能被修改
+    ParseResult parse(const char *data, size_t len);
+
+    // 清空解析状态以便解析同一连接上的下一个请求
+    void reset();
+
+    // 请求头是否已完整
+    bool headersComplete() const
+    {
+        return state == ParseState::BODY || state == ParseState::COMPLETE;
+    }
 
-    // 解析HTTP请求
-    bool parse(int client_socket);
+    // 请求头和请求体的总长度, 请求处理完毕后从缓冲区中取走
+    size_t messageLength() const
+    {
+        return header_length + content_length;
+    }
 
     // Getter方法（体现封装）
-    const std::string &getMethod() const // 获取请求方法
+    std::string_view getMethod() const // 获取请求方法
     {
         return method;
     }
-    const std::string &getUrl() const // 获取请求的URL
+    std::string_view getUrl() const // 获取请求的URL
     {
-        return url;
+        return view(url);
     }
     const std::string &getPath() const // 获取请求的路径
     {
         return path;
     }
-    const std::string &getQueryString() const // 获取查询字符串
+    std::string_view getQueryString() const // 获取查询字符串
+    {
+        return view(query_string);
+    }
+    std::string_view getVersion() const // 获取协议版本
     {
-        return query_string;
+        return view(version);
+    }
+    std::string_view getBody() const // 获取请求体
+    {
+        return std::string_view(base + header_length, content_length);
     }
     bool isCgi() const // 判断是否为CGI请求
     {
         return is_cgi;
     }
+    bool isStatus() const // 判断是否为状态页请求
+    {
+        return is_status;
+    }
+    const FastCgiBackend *getFastCgiBackend() const // 获取路由到的FastCGI后端, 不是FastCGI请求时为nullptr
+    {
+        return fastcgi_backend;
+    }
+    std::string_view getScriptName() const // 获取URL解码后的脚本路径, 以'/'开头
+    {
+        return std::string_view(path).substr(script_offset);
+    }
 
-    // 获取错误信息的方法
+    // 获取错误信息的方法, 请求格式正确但文件不可访问时同样会设置
     const std::string &getErrorMessage() const;
 
-    // 获取HTTP头的方法
-    std::string getHeader(const std::string &name) const;
-    const std::map<std::string, std::string> &getHeaders() const
+    // 获取HTTP头的方法, 名称不区分大小写, 未找到返回空
+    std::string_view getHeader(std::string_view name) const;
+
+    // 按下标遍历HTTP头, 用于把全部头部转发给FastCGI后端
+    size_t getHeaderCount() const
+    {
+        return header_count;
+    }
+    std::string_view getHeaderName(size_t index) const
+    {
+        return view(headers[index].name);
+    }
+    std::string_view getHeaderValue(size_t index) const
     {
-        return headers;
+        return view(headers[index].value);
     }
 
     // 获取配置参数的方法
-    const std::string &getDocRoot() const
+    std::string_view getDocRoot() const
     {
         return DOC_ROOT;
     }
     // 获取文档根目录
-    const std::string &getDefaultDocument() const
+    std::string_view getDefaultDocument() const
     {
         return DEFAULT_DOCUMENT;
     }
+    // 获取静态文件缓存
+    FileCache *getFileCache() const
+    {
+        return file_cache;
+    }
 
     // 友元函数用于调试输出
     friend std::ostream &operator<<(std::ostream &os, const HttpRequest &req); // 重载输出运算符‘<<’用于打印请求信息
@@ -7,14 +7,23 @@
  * @Description: HTTP响应类定义，负责创建和发送符合HTTP协议的服务器响应
  * 支持设置状态码、头部信息和响应体，提供了流式API设计
  * 包含常用HTTP状态的工厂方法，简化200/404/400/500等标准响应的创建
- * 实现了文件传输功能，支持高效发送静态文件内容
+ * 实现了文件传输功能，文件内容通过sendfile零拷贝发送
  * 自动添加标准头信息，确保响应符合HTTP规范要求
+ * 响应使用HTTP/1.1, 总是带有Content-Length和根据连接状态生成的Connection头, 以支持持久连接
+ * 错误响应在启动时预先生成完整的报文, 发送时只填入缓存的Date值, 不再构造头部和响应体
+ * 503响应带Retry-After头, 也可以不经过连接对象直接写入socket, 用于过载时低开销地拒绝新连接
  */
 #ifndef HTTP_RESPONSE_H
 #define HTTP_RESPONSE_H
 
+#include <cstddef>
 #include <map>
 #include <string>
+#include <sys/types.h>
+#include <vector>
+
+// 前向声明
+class HttpConnection;
 
 class HttpResponse
 {
@@ -27,6 +36,26 @@ class HttpResponse
     // 添加标准头部信息
     void addStandardHeaders();
 
+    // 发送响应行和头部, 补充Connection头
+    void sendHead(HttpConnection &conn);
+
+    // 预先生成的错误响应报文
+    struct ErrorResponse
+    {
+        int status_code;
+        std::string wire[2];   // [0]关闭连接, [1]保持连接
+        size_t date_offset[2]; // Date值在报文中的偏移
+    };
+
+    // 由预定义响应生成所有错误响应报文
+    static std::vector<ErrorResponse> buildErrorResponses();
+
+    // 所有错误响应报文, 第一次使用时生成
+    static const std::vector<ErrorResponse> &errorResponses();
+
+    // 查找状态码对应的错误响应报文, 未知状态码返回500
+    static const ErrorResponse &findErrorResponse(int status_code);
+
   public:
     // 构造函数
     HttpResponse();
@@ -37,14 +66,32 @@ class HttpResponse
     // 添加头部信息
     void addHeader(const std::string &name, const std::string &value);
 
+    // 生成完整的响应头(含Connection头和结尾空行), 可预先生成后缓存
+    std::string buildHead(bool keep_alive);
+
+    // 是否已设置某个头部
+    bool hasHeader(const std::string &name) const
+    {
+        return headers.find(name) != headers.end();
+    }
+
     // 设置响应体
     void setBody(const std::string &content);
 
-    // 发送响应
-    void send(int client_socket);
+    // 发送响应: 写入连接的输出缓冲区, 由写就绪事件驱动发送
+    void send(HttpConnection &conn);
+
+    // 工具方法：发送文件内容, 文件体由连接以sendfile发送, 连接接管fd
+    void sendFile(HttpConnection &conn, int fd, off_t size);
+
+    // 发送预先生成的错误响应(400/404/500/501/502/503/504), 其他状态码按500处理
+    static void sendError(HttpConnection &conn, int status_code);
+
+    // 把预先生成的错误响应(关闭连接版本)直接写入socket, 不经过输出缓冲区
+    static void writeError(int fd, int status_code);
 
-    // 工具方法：发送文件内容
-    void sendFile(int client_socket, FILE *resource);
+    // 预先生成所有错误响应报文, 应在启动工作线程前调用; retry_after为503响应的Retry-After(秒)
+    static void initErrorResponses(int retry_after);
 
     // 预定义常用响应
     static HttpResponse ok();
@@ -52,6 +99,9 @@ class HttpResponse
     static HttpResponse badRequest();
     static HttpResponse serverError();
     static HttpResponse notImplemented();
+    static HttpResponse badGateway();
+    static HttpResponse serviceUnavailable();
+    static HttpResponse gatewayTimeout();
 };
 
 #endif // HTTP_RESPONSE_H
\ No newline at end of file
@@ -6,7 +6,19 @@
  * @FilePath: /WebServerByCPP/include/HttpServer.h
  * @Description: HTTP服务器核心类，实现了Linux/Unix的网络服务器功能。
  * 负责socket初始化、客户端连接管理和请求分发
- * 采用多线程模型处理并发请求, 提供优雅的启动和关闭机制
+ * 采用epoll边缘触发的Reactor模型: 主线程的事件循环负责accept, 新连接轮询分配给固定数量的IO线程
+ * 每个IO线程运行一个EventLoop, 以非阻塞方式复用处理其上的所有连接, 提供优雅的启动和关闭机制
+ * 可选SO_REUSEPORT分片监听: 每个IO线程一个监听socket和accept循环, 监听队列长度可配置
+ * 事件循环可选epoll或io_uring后端, io_uring后端由多次accept/recv交付新连接和数据, 系统调用在循环内批量提交
+ * 请求处理器按类型在两个通道中执行: 静态文件在工作线程池中同步执行, CGI在协程执行器中异步执行, 各自有并发上限和任务队列
+ * 静态文件线程池在配置的上下限之间弹性伸缩, 主循环定期采样任务排队时间和线程利用率, 伸缩结果记录日志并显示在状态页
+ * 慢速CGI占满自己的通道时不影响静态文件的延迟; 任务队列已满时直接返回503, 避免线程和内存无限增长
+ * 可按路径前缀或扩展名把动态请求路由到常驻的FastCGI后端, 在CGI通道中经由连接池转发, 不为每个请求创建进程
+ * 可配置状态页路径, 显示各通道的线程数、正在执行/排队的任务数和累计完成/拒绝数
+ * 准入控制: 连接数达到上限时新连接直接收到预先生成的503并被关闭; 请求开始处理时检查排队时间,
+ * 超过期限或被该通道的CoDel判定为积压时返回503(带Retry-After), 过载时把处理能力留给排队时间短的请求
+ * 支持HTTP/1.1持久连接, 空闲超时和每个连接的最大请求数可配置
+ * 热点静态文件缓存在所有工作线程间共享, 由主事件循环处理inotify事件使其失效
  * 遵循RAII设计原则, 通过构造函数和析构函数自动管理资源
  * 使用C++11标准库特性如std::thread和std::atomic实现线程安全的并发控制
  * 类设计禁止复制, 确保服务器实例的唯一性和资源安全
@@ -15,6 +27,9 @@
 #define HTTP_SERVER_H
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
@@ -25,21 +40,66 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+// 前向声明
+class CoDel;
+class EventLoop;
+class Executor;
+class FastCgiRoutes;
+class FileCache;
+class ThreadPool;
+
 class HttpServer
 {
   private:
     // 成员变量
     unsigned short port;              // 服务器端口
-    int server_socket;                // 服务器socket
+    std::vector<int> listen_sockets;  // 监听socket(非阻塞), 启用reuse_port时每个IO线程一个
     std::atomic<bool> running;        // 运行状态标志
-    std::vector<std::thread> threads; // 线程池
+    std::vector<std::thread> threads; // IO线程, 每个线程运行一个io_loops中的事件循环
+
+    std::unique_ptr<EventLoop> main_loop;           // 主事件循环, 负责accept
+    std::vector<std::unique_ptr<EventLoop>> io_loops; // IO事件循环
+    size_t next_loop;                               // 轮询分配连接的下标
+    int io_thread_count;                            // IO线程数量
+    bool reuse_port;                                // 是否每个IO线程使用独立的SO_REUSEPORT监听socket
+    int listen_backlog;                             // 监听队列长度
+    bool inherited_socket;                          // 监听socket是否继承自主进程(多进程模式)
+    bool use_io_uring;                              // 事件循环是否使用io_uring后端
+    std::unique_ptr<ThreadPool> static_pool;        // 静态文件通道, 执行静态文件处理器
+    int pool_adjust_interval;                       // 静态文件线程池的伸缩采样间隔(毫秒)
+    std::unique_ptr<Executor> cgi_executor;         // CGI通道, 以协程执行CGI处理器
+    std::unique_ptr<FileCache> file_cache;          // 热点静态文件缓存, 未启用时为空
+    std::unique_ptr<FastCgiRoutes> fastcgi_routes;  // FastCGI路由表, 未配置路由时为空
 
     std::string doc_root;         // 文档根目录
     std::string default_document; // 默认文档
+    int keep_alive_timeout;       // 持久连接空闲超时(毫秒)
+    int header_timeout;           // 读取请求头的时限(毫秒)
+    int body_timeout;             // 读取请求体的时限(毫秒)
+    int write_timeout;            // 发送响应时没有进展的时限(毫秒)
+    int max_keep_alive_requests;  // 每个连接最多处理的请求数
+    std::string status_path;      // 状态页的URL路径, 为空时不启用
+
+    // 准入控制
+    int max_connections;                      // 连接数上限, 0表示不限制
+    std::atomic<int> connection_count;        // 当前连接数
+    std::chrono::milliseconds queue_deadline; // 请求在通道中排队的最长时间, 0表示不限制
+    std::unique_ptr<CoDel> static_codel;      // 静态文件通道的CoDel, 未启用时为空
+    std::unique_ptr<CoDel> cgi_codel;         // CGI通道的CoDel, 未启用时为空
+    std::atomic<uint64_t> rejected_connections; // 因连接数达到上限被拒绝的连接数
+    std::atomic<uint64_t> deadline_drops;       // 因排队超过期限被拒绝的请求数
+    std::atomic<uint64_t> codel_drops;          // 被CoDel丢弃的请求数
 
     // 私有方法
-    void handleClient(int client_socket); // 处理客户端请求
-    void initSocket();                    // 初始化socket
+    void handleAccept(int listen_socket, EventLoop *owner); // 接受所有就绪的新连接, owner为空时轮询分配给IO线程
+    void acceptConnection(int client_sock, const struct sockaddr_in &client_addr, EventLoop *owner); // 接管一个新连接
+    void addListener(EventLoop *loop, int listen_socket, uint32_t events, EventLoop *owner); // 在loop上监听新连接
+    void initSocket();                                      // 初始化所有监听socket
+    void closeSockets();                                    // 关闭所有监听socket
+    void schedulePoolAdjust();                              // 在主循环中定期调整静态文件线程池的线程数
+
+    static constexpr int POOL_GROW_SAMPLES = 2;   // 连续多少次采样排队过久才扩容
+    static constexpr int POOL_SHRINK_SAMPLES = 5; // 连续多少次采样负载过低才缩容
 
     // 阻止复制
     HttpServer(const HttpServer &) = delete;            // 禁止复制构造函数
@@ -56,11 +116,63 @@ class HttpServer
     {
         return default_document;
     }
+    ThreadPool &getStaticPool() // 获取静态文件通道
+    {
+        return *static_pool;
+    }
+    Executor &getCgiExecutor() // 获取CGI通道
+    {
+        return *cgi_executor;
+    }
+    const std::string &getStatusPath() const // 获取状态页路径, 为空表示不启用
+    {
+        return status_path;
+    }
+    std::string buildStatus() const; // 生成状态页内容(纯文本), 可在任意线程调用
+
+    // 在通道中排队到dispatched_at的请求即将开始处理, 返回false表示应以503拒绝; 可在任意线程调用
+    bool admitQueued(bool cgi_lane, std::chrono::steady_clock::time_point dispatched_at);
+    void connectionClosed() // 连接对象释放时调用, 更新连接数
+    {
+        connection_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    FileCache *getFileCache() // 获取静态文件缓存, 未启用时返回nullptr
+    {
+        return file_cache.get();
+    }
+    const FastCgiRoutes *getFastCgiRoutes() const // 获取FastCGI路由表, 未配置时返回nullptr
+    {
+        return fastcgi_routes.get();
+    }
+    int getKeepAliveTimeout() const // 获取持久连接空闲超时(毫秒)
+    {
+        return keep_alive_timeout;
+    }
+    int getHeaderTimeout() const // 获取读取请求头的时限(毫秒)
+    {
+        return header_timeout;
+    }
+    int getBodyTimeout() const // 获取读取请求体的时限(毫秒)
+    {
+        return body_timeout;
+    }
+    int getWriteTimeout() const // 获取发送响应停滞的时限(毫秒)
+    {
+        return write_timeout;
+    }
+    int getMaxKeepAliveRequests() const // 获取每个连接最多处理的请求数
+    {
+        return max_keep_alive_requests;
+    }
     ~HttpServer(); // 析构函数
 
+    // 创建一个绑定到指定端口的监听socket(非阻塞), 失败时抛出异常
+    static int createListenSocket(unsigned short port, int listen_backlog, bool reuse_port);
+
     // 主要接口
-    void start(); // 启动服务器
-    void stop();  // 停止服务器
+    void setListenSocket(int listen_socket); // 使用继承的监听socket, 必须在start()之前调用
+    void start();                            // 启动服务器
+    void stop();                             // 停止服务器
 };
 
 #endif // HTTP_SERVER_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 11:02:37
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 11:02:37
+ * @FilePath: /WebServerByCPP/include/IoUring.h
+ * @Description: io_uring的最小封装, 直接使用io_uring_setup/io_uring_enter/io_uring_register系统调用, 不依赖liburing
+ * 提交队列项先在用户态排队, 由一次io_uring_enter统一提交并等待完成事件, 从而在一个事件循环的所有连接间批量收发
+ * 环的fd注册到提交线程(registered ring fd), 省去每次io_uring_enter查找文件的开销
+ * 提供一组注册到内核的接收缓冲区(provided buffer ring), 多次接收(multishot recv)时由内核自行挑选缓冲区
+ * 只在所属EventLoop的线程中使用, 不加锁
+ */
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+class IoUring
+{
+  private:
+    int ring_fd;          // io_uring实例
+    int enter_fd;         // 调用io_uring_enter时使用的fd, 注册成功后为注册的下标
+    unsigned enter_flags; // io_uring_enter的附加标志
+
+    // 提交队列
+    void *sq_ring;               // 映射的提交队列环
+    size_t sq_ring_size;
+    unsigned *sq_head;           // 内核已消费的位置
+    unsigned *sq_tail;           // 用户态已发布的位置
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;   // 提交队列项数组
+    size_t sqes_size;
+    unsigned sqe_tail;           // 已填写但尚未发布的位置
+
+    // 完成队列
+    void *cq_ring;               // 映射的完成队列环, 支持单次映射时与sq_ring相同
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // 接收缓冲区环
+    // 头文件中的io_uring_buf_ring在C++中因空结构体占位而错开8字节, 直接按io_uring_buf数组访问
+    struct io_uring_buf *buf_ring;      // 与内核共享的缓冲区描述环
+    char *buf_base;                     // 全部缓冲区的连续内存
+    unsigned buf_count;                 // 缓冲区个数(2的幂)
+    unsigned buf_size;                  // 每个缓冲区的字节数
+    uint16_t buf_group;                 // 缓冲区组号
+    uint16_t buf_tail;                  // 用户态的环尾
+
+    // 发布已填写的提交队列项
+    void flush();
+
+    // 阻止复制
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+  public:
+    // 创建队列长度为entries的io_uring实例, 内核不支持所需特性时抛出异常
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    // 在提交线程中注册环fd, 之后只能由该线程调用submitAndWait
+    void registerRingFd();
+
+    // 取得一个清零的提交队列项, 队列已满时先提交已有的项
+    struct io_uring_sqe *getSqe();
+
+    // 提交全部已填写的项, 并至少等待wait_nr个完成事件, 出错时返回-errno
+    int submitAndWait(unsigned wait_nr);
+
+    // 取出一个完成事件(复制后立即归还队列空间), 没有时返回false
+    bool popCompletion(struct io_uring_cqe &cqe);
+
+    // 注册count个size字节的接收缓冲区, 作为group号缓冲区组, 失败时返回false
+    bool setupBufferRing(uint16_t group, unsigned count, unsigned size);
+
+    bool hasBufferRing() const
+    {
+        return buf_ring != nullptr;
+    }
+
+    uint16_t bufferGroup() const
+    {
+        return buf_group;
+    }
+
+    // 内核选中的缓冲区地址
+    const char *bufferAddress(uint16_t id) const
+    {
+        return buf_base + static_cast<size_t>(id) * buf_size;
+    }
+
+    // 数据取走后把缓冲区归还给内核
+    void recycleBuffer(uint16_t id);
+};
+
+#endif // IO_URING_H
\ No newline at end of file
@@ -0,0 +1,57 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 09:12:36
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 09:12:36
+ * @FilePath: /WebServerByCPP/include/MasterProcess.h
+ * @Description: 多进程模式的主进程, 创建监听socket后fork出固定数量的工作进程共享该socket
+ * 每个工作进程绑定到一个CPU并运行完整的HttpServer, 彼此不共享堆, 单个进程崩溃不影响其他进程
+ * 主进程不创建任何线程, 只负责等待工作进程退出并在原来的CPU上重新启动, 收到SIGINT/SIGTERM时通知所有工作进程退出
+ */
+#ifndef MASTER_PROCESS_H
+#define MASTER_PROCESS_H
+
+#include <ctime>
+#include <functional>
+#include <sys/types.h>
+#include <vector>
+
+class MasterProcess
+{
+  public:
+    // 工作进程入口, 参数为继承的监听socket, 返回值作为进程退出码
+    using WorkerMain = std::function<int(int listen_socket)>;
+
+  private:
+    struct Worker
+    {
+        pid_t pid;          // 进程号, 未运行时为-1
+        int cpu;            // 绑定的CPU编号, 无法绑定时为-1
+        time_t start_time;  // 最近一次启动时间
+    };
+
+    unsigned short port;         // 监听端口
+    int listen_backlog;          // 监听队列长度
+    int listen_socket;           // 所有工作进程共享的监听socket
+    std::vector<Worker> workers; // 工作进程槽位
+    WorkerMain worker_main;      // 工作进程入口
+
+    // 在指定槽位上启动工作进程
+    void spawnWorker(size_t slot);
+
+    // 通知所有工作进程退出并等待
+    void stopWorkers();
+
+    // 阻止复制
+    MasterProcess(const MasterProcess &) = delete;
+    MasterProcess &operator=(const MasterProcess &) = delete;
+
+  public:
+    MasterProcess(unsigned short port, int worker_count, int listen_backlog);
+    ~MasterProcess();
+
+    // 启动所有工作进程并监控, 直到收到SIGINT/SIGTERM, 返回进程退出码
+    int run(WorkerMain main_function);
+};
+
+#endif // MASTER_PROCESS_H
\ No newline at end of file
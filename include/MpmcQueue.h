@@ -0,0 +1,163 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 13:05:42
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 13:05:42
+ * @FilePath: /WebServerByCPP/include/MpmcQueue.h
+ * @Description: 有界无锁多生产者多消费者环形队列(Vyukov算法), 用于线程间传递任务
+ * 每个槽位带一个序号, 生产者和消费者各自用CAS推进写/读位置, 通过槽位序号判断槽位是否可写/可读, 不使用互斥锁
+ * 批量出队时一次CAS认领多个连续的已写入槽位, 减少消费者之间的竞争
+ * 容量向上取整为2的幂; 队列已满时入队失败, 由调用者决定拒绝还是另行暂存
+ */
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class MpmcQueue
+{
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    // 每个槽位独占缓存行, 相邻槽位的读写不会互相失效
+    struct alignas(CACHE_LINE) Cell
+    {
+        std::atomic<size_t> sequence; // 等于位置时可写, 等于位置+1时可读
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos; // 下一个写入位置
+    alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos; // 下一个读取位置
+
+    static size_t roundUpCapacity(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    // 阻止复制
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+  public:
+    explicit MpmcQueue(size_t capacity)
+        : cells(new Cell[roundUpCapacity(capacity)]), mask(roundUpCapacity(capacity) - 1), enqueue_pos(0),
+          dequeue_pos(0)
+    {
+        for (size_t i = 0; i <= mask; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    // 入队, 队列已满时返回false且value保持不变
+    bool tryPush(T &&value)
+    {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                // 槽位可写, 认领该位置
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // 槽位仍未被读走, 队列已满
+            }
+            else
+            {
+                pos = enqueue_pos.load(std::memory_order_relaxed); // 被其他生产者抢先
+            }
+        }
+
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 出队一个元素, 队列为空时返回false
+    bool tryPop(T &value)
+    {
+        return popBatch(&value, 1) == 1;
+    }
+
+    // 批量出队最多max_count个元素到out, 返回实际个数; 一次CAS认领连续的多个槽位
+    size_t popBatch(T *out, size_t max_count)
+    {
+        if (max_count == 0)
+            return 0;
+
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        size_t count;
+        while (true)
+        {
+            // 从pos开始数出连续的已写入槽位
+            count = 0;
+            while (count < max_count)
+            {
+                size_t sequence = cells[(pos + count) & mask].sequence.load(std::memory_order_acquire);
+                if (sequence != pos + count + 1)
+                    break;
+                ++count;
+            }
+
+            if (count == 0)
+            {
+                // 第一个槽位尚未写入: 队列为空, 或读位置已被其他消费者推进
+                size_t current = dequeue_pos.load(std::memory_order_relaxed);
+                if (current == pos)
+                    return 0;
+                pos = current;
+                continue;
+            }
+
+            if (dequeue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+                break;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Cell &cell = cells[(pos + i) & mask];
+            out[i] = std::move(cell.data);
+            cell.data = T();
+            cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // 近似的元素个数, 并发修改时只作参考
+    size_t sizeApprox() const
+    {
+        size_t head = dequeue_pos.load(std::memory_order_relaxed);
+        size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool emptyApprox() const
+    {
+        return sizeApprox() == 0;
+    }
+};
+
+#endif // MPMC_QUEUE_H
\ No newline at end of file
@@ -8,19 +8,27 @@
  * 采用C++面向对象设计, 通过抽象基类和继承体现多态特性
  * 包含纯虚函数作为接口规范, 强制子类实现特定行为
  * 使用工厂方法模式动态创建适合不同请求类型的处理器实例
- * 主要包含静态文件处理器和CGI处理器两种具体实现
+ * 主要包含静态文件处理器、CGI处理器和FastCGI处理器三种具体实现
  * 采用智能指针管理内存, 确保资源安全
+ * 处理器另有协程版本handleAsync, 在执行器的事件循环中运行, 等待IO时挂起而不占用线程; CGI处理器以此异步读写管道
  * 设计遵循开闭原则, 便于未来扩展更多请求处理类型, 如动态内容生成、API处理等
  */
 #ifndef REQUEST_HANDLER_H
 #define REQUEST_HANDLER_H
 
 #include "HttpRequest.h"
+#include "Task.h"
+#include <chrono>
 #include <memory>
 #include <string>
+#include <sys/types.h>
 
 // 前向声明
+class EventLoop;
+struct FastCgiBackend;
+class FileCache;
 class HttpResponse;
+class HttpConnection;
 
 // 抽象基类 - 体现多态
 class RequestHandler
@@ -35,8 +43,11 @@ class RequestHandler
     // 虚析构函数
     virtual ~RequestHandler() = default;
 
-    // 纯虚函数 - 必须被子类实现
-    virtual void handle(const HttpRequest &request, int client_socket) = 0;
+    // 纯虚函数 - 必须被子类实现, 响应写入连接的输出缓冲区
+    virtual void handle(const HttpRequest &request, HttpConnection &conn) = 0;
+
+    // 协程版本, 在loop所在线程中执行, 只能使用loop上的异步操作等待IO; 默认直接调用handle
+    virtual Task<void> handleAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop);
 
     // 工厂方法
     static std::unique_ptr<RequestHandler> createHandler(const HttpRequest &request);
@@ -46,13 +57,15 @@ class RequestHandler
 class StaticFileHandler : public RequestHandler
 {
   public:
-    explicit StaticFileHandler(const std::string &root = "httpdocs");
+    explicit StaticFileHandler(const std::string &root = "httpdocs", FileCache *cache = nullptr);
 
     // 实现基类的纯虚函数
-    void handle(const HttpRequest &request, int client_socket) override;
+    void handle(const HttpRequest &request, HttpConnection &conn) override;
 
   private:
-    void serveFile(const std::string &path, int client_socket);
+    FileCache *file_cache; // 热点文件缓存, 为nullptr时总是从磁盘发送
+
+    void serveFile(const std::string &path, HttpConnection &conn);
 };
 
 // CGI处理器
@@ -61,11 +74,67 @@ class CgiHandler : public RequestHandler
   public:
     explicit CgiHandler(const std::string &root = "httpdocs"); // 初始化CGI处理器, 设置CGI脚本根目录
 
-    // 实现基类的纯虚函数
-    void handle(const HttpRequest &request, int client_socket) override;
+    // 实现基类的纯虚函数; CGI请求总是在执行器中异步处理, 不会到达这里
+    void handle(const HttpRequest &request, HttpConnection &conn) override;
+
+    // 异步执行: 写入请求体和读取输出时挂起, 不阻塞线程
+    Task<void> handleAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop) override;
+
+    // 设置脚本的运行时限(秒)和输出大小上限(字节), 超出时终止脚本; 0表示不限制, 应在启动执行器之前调用
+    static void setLimits(int timeout_seconds, size_t max_output_bytes);
+
+  private:
+    // 运行中的CGI脚本
+    struct CgiProcess
+    {
+        pid_t pid;        // 本进程以posix_spawn启动的子进程, 由CGI辅助进程启动时为-1
+        pid_t script_pid; // 由CGI辅助进程启动的脚本进程, 只在没有pidfd时用于终止脚本; 尚未收到报告时为-1
+        int pid_fd;       // 脚本进程的pidfd, 用于终止脚本和等待其退出; 尚未取得时为-1
+        int report_fd;    // 由CGI辅助进程启动时, 脚本从这里发回自己的pid、pidfd和exec的结果; 报告到达后关闭, 否则为-1
+        int input_fd;  // 写入脚本标准输入的管道
+        int output_fd; // 读取脚本标准输出的管道
+    };
+
+    static constexpr int CGI_REAP_INTERVAL_MS = 100; // 没有pidfd时检查子进程是否退出的间隔
+
+    static int timeout_ms;     // 从启动脚本开始计算的运行时限(毫秒), 0表示不限制
+    static size_t max_output;  // 脚本输出的最大字节数, 0表示不限制
+
+    // 创建管道并启动脚本, client_socket用于生成REMOTE_ADDR等变量; 父进程一端为非阻塞
+    // 失败时返回false
+    bool startCgi(const HttpRequest &request, const std::string &path, int client_socket, CgiProcess &process);
+
+    Task<void> executeCgiAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop); // CGI脚本执行函数
+
+    // 读取CGI辅助进程启动的脚本发回的报告, 取得的pid和pidfd存入script_pid和pid_fd; 报告到达后关闭report_fd
+    // 报告还没有到达(脚本尚未开始运行)时report_fd保持打开, 由reapCgi继续等待
+    // exec失败或请求没有交给子进程时返回false; posix_spawn启动的脚本总是返回true
+    static bool receiveReport(CgiProcess &process);
+
+    // 以SIGKILL终止脚本; 报告还没有到达时什么也不做, 由reapCgi在报告到达后按期限终止
+    static void killCgi(CgiProcess &process);
+
+    // 脚本是否已经退出, 本进程的子进程同时被回收; 报告还没有到达时返回false
+    static bool cgiExited(CgiProcess &process);
+
+    // 等待报告到达和脚本退出并回收, 超过期限时终止脚本; 不关联任何连接, 负责关闭pid_fd和report_fd
+    static Task<void> reapCgi(EventLoop &loop, CgiProcess process, std::chrono::steady_clock::time_point deadline);
+};
+
+// FastCGI处理器, 把请求转发给路由到的常驻后端, 不创建进程
+class FastCgiHandler : public RequestHandler
+{
+  public:
+    FastCgiHandler(const std::string &root, const FastCgiBackend &backend);
+
+    // 只能在执行器线程中处理, 同步版本返回500
+    void handle(const HttpRequest &request, HttpConnection &conn) override;
+
+    // 通过执行器线程的连接池发送请求, 等待响应时挂起
+    Task<void> handleAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop) override;
 
   private:
-    void executeCgi(const HttpRequest &request, int client_socket, std::string path); // CGI脚本执行函数
+    const FastCgiBackend &backend;
 };
 
 #endif // REQUEST_HANDLER_H
\ No newline at end of file
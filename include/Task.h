@@ -0,0 +1,228 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 15:02:18
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 15:02:18
+ * @FilePath: /WebServerByCPP/include/Task.h
+ * @Description: C++20协程任务类型Task<T>, 用于编写等待IO时挂起而不占用线程的请求处理器
+ * 任务是惰性的: 创建时不执行, 被co_await时才开始, 结束时通过对称转移直接恢复等待者, 嵌套等待不增加栈深度
+ * 任务中未捕获的异常保存在promise中, 在等待者co_await的位置重新抛出
+ * 顶层任务由spawnTask启动, 不需要等待者, 结束后自动释放
+ */
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+template <typename T = void>
+class Task;
+
+// promise的公共部分: 等待者和异常
+class TaskPromiseBase
+{
+  public:
+    std::coroutine_handle<> continuation; // co_await本任务的协程, 本任务结束时恢复它
+    std::exception_ptr exception;         // 任务中未捕获的异常
+
+    // 结束时转入等待者, 没有等待者时返回到resume的调用者
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        exception = std::current_exception();
+    }
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase
+{
+  private:
+    std::optional<T> value;
+
+  public:
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U &&result)
+    {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T result()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase
+{
+  public:
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept
+    {
+    }
+
+    void result()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+};
+
+template <typename T>
+class Task
+{
+  public:
+    using promise_type = TaskPromise<T>;
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+
+    // 阻止复制
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+  public:
+    explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept : handle(coroutine)
+    {
+    }
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr))
+    {
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    // co_await任务: 记录等待者后转入任务执行, 任务结束时恢复等待者并取得结果
+    auto operator co_await() const noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept
+            {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept
+            {
+                handle.promise().continuation = waiter;
+                return handle;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().result();
+            }
+        };
+        return Awaiter{handle};
+    }
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// 不被等待的顶层协程, 立即开始执行, 结束后自动释放
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+            std::terminate(); // spawnTask已捕获任务的异常, 不会到达这里
+        }
+    };
+};
+
+// 在当前线程启动任务, 第一次挂起时返回; 任务中未捕获的异常只记录日志
+inline DetachedTask spawnTask(Task<void> task)
+{
+    try
+    {
+        co_await task;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "协程任务异常: " << e.what() << '\n';
+    }
+}
+
+#endif // TASK_H
\ No newline at end of file
@@ -0,0 +1,226 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 11:05:36
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 16:12:40
+ * @FilePath: /WebServerByCPP/include/ThreadPool.h
+ * @Description: 工作线程池, 线程数可以固定, 也可以在上下限之间弹性伸缩, 从有界任务队列中取任务执行
+ * 队列已满时tryPost直接返回false而不是阻塞或无限增长, 由调用者决定如何拒绝请求(例如返回503)
+ * 其他线程提交的任务进入全局注入队列(无锁MPMC环形队列), 工作线程按排队长度批量取出, 减少对队列的争用
+ * 每个工作线程还有一个本地工作窃取队列: 批量取出的其余任务放入本地队列, 工作线程自己提交的任务也直接放入本地队列
+ * 本地和注入队列都为空的线程从其他线程的本地队列窃取任务, 因此一个慢任务(例如CGI)不会挡住同批取出的其他请求
+ * 队列为空时工作线程先短暂自旋(单核时不自旋), 仍没有任务才在自己的eventfd上休眠
+ * 提交者只在有线程休眠时才认领其中一个并写它的eventfd, 每个任务最多唤醒一个线程
+ * 记录正在执行、已完成和因队列已满被拒绝的任务数, 供状态页查看
+ * 弹性伸缩: 每个任务记录排队时间和执行时间, 由调用者定期调用adjust()采样平均排队时间和线程利用率,
+ * 连续多次排队过久时扩容, 连续多次利用率低且几乎不排队时每次退出一个线程; 扩容和缩容的条件之间留有间隔, 避免来回抖动
+ * 线程的槽位按上限预先分配, 退出的线程先执行完本地队列中的任务, 其槽位之后可以被新线程复用
+ * 析构时停止接收新任务, 丢弃尚未开始的任务并等待正在执行的任务完成
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "MpmcQueue.h"
+#include "WorkStealingDeque.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+  public:
+    using Task = std::function<void()>;
+
+    // 弹性伸缩的参数, min_threads等于max_threads时线程数固定
+    struct ResizePolicy
+    {
+        size_t min_threads;        // 线程数下限
+        size_t max_threads;        // 线程数上限
+        int64_t grow_wait_us;      // 平均排队时间超过该值(微秒)时扩容
+        double shrink_utilization; // 利用率低于该值且平均排队时间不超过扩容阈值的1/4时缩容
+        int grow_samples;          // 连续多少次采样满足条件才扩容
+        int shrink_samples;        // 连续多少次采样满足条件才缩容
+    };
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr int SPIN_COUNT = 200;                   // 多核时休眠前的自旋次数
+    static constexpr size_t MAX_BATCH = 16;                  // 一次最多从注入队列取出的任务数
+    static constexpr size_t LOCAL_CAPACITY = 256;            // 本地队列容量
+    static constexpr unsigned INJECTION_CHECK_INTERVAL = 61; // 每执行这么多个任务先检查一次注入队列
+
+    // 排队中的任务及其提交时间
+    struct Job
+    {
+        Task fn;
+        Clock::time_point queued_at;
+    };
+
+    // 每个工作线程槽位的状态, 独占缓存行
+    struct alignas(64) WorkerState
+    {
+        WorkerState()
+            : local(LOCAL_CAPACITY), wakeup_fd(-1), parked(false), retiring(false), exited(false), task_count(0),
+              wait_ns(0), busy_ns(0)
+        {
+        }
+
+        WorkStealingDeque<Job> local;     // 本地队列, 本线程从底部存取, 其他线程从顶部窃取
+        int wakeup_fd;                    // 休眠时阻塞读取的eventfd
+        std::atomic<bool> parked;         // 是否已休眠(或即将休眠), 由唤醒者或自己置回false
+        std::atomic<bool> retiring;       // 缩容时要求该线程退出
+        std::atomic<bool> exited;         // 线程已退出, 槽位可以回收
+
+        // 只由本槽位的线程写入的累计统计, 线程退出后保留
+        std::atomic<uint64_t> task_count; // 执行过的任务数
+        std::atomic<uint64_t> wait_ns;    // 任务排队时间之和
+        std::atomic<uint64_t> busy_ns;    // 任务执行时间之和
+    };
+
+    std::vector<std::thread> workers;       // 每个槽位的线程, 未使用的槽位不可join
+    size_t max_workers;                     // 槽位数, 即线程数上限
+    MpmcQueue<Job *> injection;             // 全局注入队列, 接收非工作线程提交的任务
+    std::unique_ptr<WorkerState[]> states;  // 每个槽位一个
+    std::atomic<size_t> slot_count;         // 用过的槽位数(只增不减), 窃取和检查队列时只遍历这些槽位
+    std::atomic<size_t> live_workers;       // 运行中且未被要求退出的线程数
+    std::atomic<int> idle_workers;          // 休眠的工作线程数, 为0时提交者无需查找
+    std::atomic<size_t> next_sleeper;       // 查找休眠线程的起始位置, 轮流唤醒
+    std::atomic<bool> stopping;             // 停止标志
+    int spin_count;                         // 休眠前检查队列的次数
+
+    // 统计
+    std::atomic<int> active_tasks;          // 正在执行的任务数
+    std::atomic<uint64_t> completed_tasks;  // 已执行完的任务数
+    std::atomic<uint64_t> rejected_tasks;   // 因队列已满被拒绝的任务数
+
+    // 弹性伸缩, 由resize_mutex保护(统计结果除外)
+    std::mutex resize_mutex;
+    ResizePolicy policy;
+    Clock::time_point last_sample_time;     // 上次采样的时间
+    uint64_t last_task_count;               // 上次采样时的累计值
+    uint64_t last_wait_ns;
+    uint64_t last_busy_ns;
+    int grow_streak;                        // 连续满足扩容条件的采样次数
+    int shrink_streak;                      // 连续满足缩容条件的采样次数
+    std::atomic<int64_t> sampled_wait_us;   // 最近一次采样的平均排队时间(微秒)
+    std::atomic<int> sampled_utilization;   // 最近一次采样的利用率(百分比)
+    std::atomic<uint64_t> grow_events;      // 扩容次数
+    std::atomic<uint64_t> shrink_events;    // 缩容次数
+
+    // 工作线程主循环
+    void workerLoop(size_t index);
+
+    // 在空闲槽位上启动最多count个线程, 返回实际启动数; 调用者持有resize_mutex
+    size_t startWorkers(size_t count);
+
+    // 要求编号最大的一个运行中线程退出; 调用者持有resize_mutex
+    bool retireWorker();
+
+    // 从注入队列批量取出任务, 返回第一个, 其余放入本地队列
+    Job *takeFromInjection(size_t index, std::vector<Job *> &batch);
+
+    // 从其他线程的本地队列窃取一个任务
+    Job *stealTask(size_t index, unsigned seed);
+
+    // 注入队列或任一本地队列中是否有任务(近似)
+    bool hasPendingTasks() const;
+
+    // 执行并释放任务, 计入所在槽位的统计
+    void runTask(Job *job, WorkerState &self);
+
+    // 没有任务时自旋等待, 仍没有任务则在自己的eventfd上休眠
+    void waitForTask(size_t index);
+
+    // 认领一个休眠的工作线程并唤醒它, 没有时返回false
+    bool wakeOne();
+
+    // 阻止复制
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+  public:
+    // 固定线程数的线程池
+    ThreadPool(size_t thread_count, size_t max_queue_size);
+
+    // 初始thread_count个线程, 在policy的上下限之间伸缩
+    ThreadPool(size_t thread_count, size_t max_queue_size, const ResizePolicy &resize_policy);
+    ~ThreadPool();
+
+    // 提交任务, 队列已满或线程池已停止时返回false; 在工作线程中调用时优先放入该线程的本地队列
+    bool tryPost(Task task);
+
+    // 停止线程池并等待所有工作线程退出
+    void stop();
+
+    // 采样自上次调用以来的排队时间和利用率, 按需扩容或缩容一次; 应以固定间隔调用
+    void adjust();
+
+    // 当前排队的任务数(近似值)
+    size_t queueSize() const;
+
+    // 工作线程数
+    size_t threadCount() const
+    {
+        return live_workers.load(std::memory_order_relaxed);
+    }
+
+    // 线程数上下限
+    size_t minThreads() const
+    {
+        return policy.min_threads;
+    }
+
+    size_t maxThreads() const
+    {
+        return policy.max_threads;
+    }
+
+    // 最近一次采样的平均排队时间(微秒)
+    int64_t sampledWaitMicros() const
+    {
+        return sampled_wait_us.load(std::memory_order_relaxed);
+    }
+
+    // 最近一次采样的线程利用率(百分比)
+    int sampledUtilization() const
+    {
+        return sampled_utilization.load(std::memory_order_relaxed);
+    }
+
+    // 扩容和缩容次数
+    uint64_t growCount() const
+    {
+        return grow_events.load(std::memory_order_relaxed);
+    }
+
+    uint64_t shrinkCount() const
+    {
+        return shrink_events.load(std::memory_order_relaxed);
+    }
+
+    // 正在执行的任务数(近似值)
+    int activeCount() const
+    {
+        return active_tasks.load(std::memory_order_relaxed);
+    }
+
+    // 已执行完的任务数
+    uint64_t completedCount() const
+    {
+        return completed_tasks.load(std::memory_order_relaxed);
+    }
+
+    // 因队列已满被拒绝的任务数
+    uint64_t rejectedCount() const
+    {
+        return rejected_tasks.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // THREAD_POOL_H
\ No newline at end of file
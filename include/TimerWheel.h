@@ -0,0 +1,85 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 10:20:44
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 10:20:44
+ * @FilePath: /WebServerByCPP/include/TimerWheel.h
+ * @Description: 分层时间轮, 由EventLoop持有, 只在循环线程中使用
+ * 第0层256个槽位, 每个槽位一个tick; 其余三层各64个槽位, 每层槽位跨度是上一层的整圈
+ * 添加和取消定时器都是O(1), 推进时只处理当前槽位, 高层槽位在低层转满一圈时逐级下放
+ * 同一tick到期的定时器(例如大量慢速连接的超时)在一次推进中集中取出并执行
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+class TimerWheel
+{
+  public:
+    using TimerId = uint64_t; // 定时器标识, 0表示无效
+    using Callback = std::function<void()>;
+
+  private:
+    static constexpr int LEVELS = 4;
+    static constexpr int ROOT_BITS = 8; // 第0层: 256个槽位
+    static constexpr int LEVEL_BITS = 6; // 第1~3层: 每层64个槽位
+    static constexpr uint64_t ROOT_SIZE = 1ULL << ROOT_BITS;
+    static constexpr uint64_t LEVEL_SIZE = 1ULL << LEVEL_BITS;
+    static constexpr uint64_t MAX_TICKS = 1ULL << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS); // 最大定时跨度
+
+    using Slot = std::list<TimerId>;
+
+    struct Timer
+    {
+        uint64_t expire_tick;     // 到期的tick
+        Callback callback;        // 到期回调
+        Slot *slot;               // 所在槽位
+        Slot::iterator position;  // 在槽位中的位置, 用于O(1)取消
+    };
+
+    Slot root[ROOT_SIZE];                     // 第0层
+    Slot levels[LEVELS - 1][LEVEL_SIZE];      // 第1~3层
+    std::unordered_map<TimerId, Timer> timers; // 所有未到期的定时器
+    uint64_t current_tick;                    // 已处理到的tick
+    TimerId next_id;
+
+    // 按到期tick把定时器放入对应层的槽位
+    void place(TimerId id, Timer &timer);
+
+    // 把第level层(1~3)index槽位中的定时器重新放入更低的层, 返回index
+    uint64_t cascade(int level, uint64_t index);
+
+  public:
+    TimerWheel();
+
+    // 在ticks个tick之后执行callback, ticks至少为1
+    TimerId add(uint64_t ticks, Callback callback);
+
+    // 取消尚未到期的定时器, 已到期或不存在时什么也不做
+    void cancel(TimerId id);
+
+    // 推进到指定tick, 执行期间到期的全部定时器
+    void advanceTo(uint64_t tick);
+
+    uint64_t currentTick() const
+    {
+        return current_tick;
+    }
+
+    bool empty() const
+    {
+        return timers.empty();
+    }
+
+    size_t size() const
+    {
+        return timers.size();
+    }
+};
+
+#endif // TIMER_WHEEL_H
\ No newline at end of file
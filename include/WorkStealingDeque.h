@@ -0,0 +1,129 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 14:10:27
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 14:10:27
+ * @FilePath: /WebServerByCPP/include/WorkStealingDeque.h
+ * @Description: 固定容量的Chase-Lev工作窃取双端队列, 元素为指针
+ * 只有所属线程在底部压入和弹出(后进先出), 其他线程从顶部窃取(先进先出), 仅在争抢最后一个元素时需要CAS
+ * 内存序参考Lê等人的弱内存模型版本; 容量固定不扩容, 队列已满时push返回false, 由调用者另行安排
+ * 窃取者只有CAS顶部成功后读到的元素才有效, 所属线程覆盖槽位之前顶部一定已越过该位置, 因此固定容量下没有ABA问题
+ */
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+template <typename T>
+class WorkStealingDeque
+{
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::unique_ptr<std::atomic<T *>[]> slots;
+    int64_t mask;
+
+    alignas(CACHE_LINE) std::atomic<int64_t> top;    // 窃取位置, 只增不减
+    alignas(CACHE_LINE) std::atomic<int64_t> bottom; // 所属线程的压入位置
+
+    static size_t roundUpCapacity(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    // 阻止复制
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  public:
+    explicit WorkStealingDeque(size_t capacity)
+        : slots(new std::atomic<T *>[roundUpCapacity(capacity)]),
+          mask(static_cast<int64_t>(roundUpCapacity(capacity)) - 1), top(0), bottom(0)
+    {
+        for (int64_t i = 0; i <= mask; ++i)
+        {
+            slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const
+    {
+        return static_cast<size_t>(mask + 1);
+    }
+
+    // 所属线程压入底部, 已满时返回false
+    bool push(T *item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > mask)
+            return false;
+
+        // 先写槽位再以release发布底部, 窃取者acquire读到新的底部时一定能看到槽位中的元素
+        slots[b & mask].store(item, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 所属线程从底部弹出, 为空或最后一个元素被窃取时返回nullptr
+    T *pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // 已空, 恢复底部
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T *item = slots[b & mask].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // 最后一个元素, 与窃取者争抢
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 其他线程从顶部窃取, 为空或与他人争抢失败时返回nullptr
+    T *steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+
+        T *item = slots[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return item;
+    }
+
+    // 近似的元素个数, 并发修改时只作参考
+    size_t sizeApprox() const
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool emptyApprox() const
+    {
+        return sizeApprox() == 0;
+    }
+};
+
+#endif // WORK_STEALING_DEQUE_H
\ No newline at end of file
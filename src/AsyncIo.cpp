@@ -0,0 +1,100 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 15:20:06
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 15:20:06
+ * @FilePath: /WebServerByCPP/src/AsyncIo.cpp
+ * @Description: 协程异步IO操作实现
+ * fd只在等待期间注册到事件循环(边缘触发), 注册时已就绪的fd会立即报告, 因此先尝试再等待不会丢失事件
+ * 就绪回调先移除注册再恢复协程, 回调对象由事件循环延迟释放, 协程恢复后可以立即再次等待同一个fd
+ */
+#include "../include/AsyncIo.h"
+#include "../include/EventLoop.h"
+#include <cerrno>
+#include <unistd.h>
+
+void FdAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+    EventLoop *owner = &loop;
+    const int watched = fd;
+    owner->addFd(watched, events | EPOLLET, [this, owner, watched, waiter](uint32_t revents) {
+        ready_events = revents;
+        owner->removeFd(watched);
+        waiter.resume();
+    });
+}
+
+TimedFdAwaiter::TimedFdAwaiter(EventLoop &loop, int fd, uint32_t events, std::chrono::steady_clock::time_point deadline)
+    : loop(loop), fd(fd), events(events), ready_events(0), timeout_ms(-1), timer(0)
+{
+    if (deadline != std::chrono::steady_clock::time_point::max())
+    {
+        // 不足1毫秒按1毫秒计, 只有期限已过时才为0
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        timeout_ms = remaining <= remaining.zero()
+                         ? 0
+                         : std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+    }
+}
+
+void TimedFdAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+    // 两个回调都在循环线程中执行, 先执行的一方移除另一方, 协程只恢复一次
+    EventLoop *owner = &loop;
+    const int watched = fd;
+    owner->addFd(watched, events | EPOLLET, [this, owner, watched, waiter](uint32_t revents) {
+        ready_events = revents;
+        owner->removeFd(watched);
+        if (timer != 0)
+            owner->cancelTimer(timer);
+        waiter.resume();
+    });
+    if (timeout_ms > 0)
+    {
+        timer = owner->runAfter(timeout_ms, [owner, watched, waiter] {
+            owner->removeFd(watched);
+            waiter.resume();
+        });
+    }
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> waiter)
+{
+    loop.runAfter(milliseconds, [waiter] { waiter.resume(); });
+}
+
+Task<ssize_t> asyncRead(EventLoop &loop, int fd, void *buf, size_t len)
+{
+    while (true)
+    {
+        ssize_t n = read(fd, buf, len);
+        if (n >= 0)
+            co_return n;
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            co_return -errno;
+        co_await waitReadable(loop, fd);
+    }
+}
+
+Task<ssize_t> asyncWrite(EventLoop &loop, int fd, const void *data, size_t len)
+{
+    const char *p = static_cast<const char *>(data);
+    size_t written = 0;
+    while (written < len)
+    {
+        ssize_t n = write(fd, p + written, len - written);
+        if (n > 0)
+        {
+            written += static_cast<size_t>(n);
+            continue;
+        }
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+            co_return -errno;
+        co_await waitWritable(loop, fd);
+    }
+    co_return static_cast<ssize_t>(written);
+}
\ No newline at end of file
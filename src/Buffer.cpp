@@ -0,0 +1,108 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 13:31:44
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 13:31:44
+ * @FilePath: /WebServerByCPP/src/Buffer.cpp
+ * @Description: 连接缓冲区实现, 负责空间管理、换行查找和基于readv的批量读取
+ */
+#include "../include/Buffer.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+
+Buffer::Buffer(size_t initial_size) : buffer(initial_size), reader_index(0), writer_index(0)
+{
+}
+
+const char *Buffer::findEOL(const char *start) const
+{
+    if (start < peek() || start >= begin() + writer_index)
+        return nullptr;
+    const void *eol = memchr(start, '\n', begin() + writer_index - start);
+    return static_cast<const char *>(eol);
+}
+
+void Buffer::retrieve(size_t len)
+{
+    if (len < readableBytes())
+    {
+        reader_index += len;
+    }
+    else
+    {
+        retrieveAll();
+    }
+}
+
+void Buffer::retrieveAll()
+{
+    reader_index = 0;
+    writer_index = 0;
+}
+
+std::string Buffer::retrieveAsString(size_t len)
+{
+    if (len > readableBytes())
+        len = readableBytes();
+    std::string result(peek(), len);
+    retrieve(len);
+    return result;
+}
+
+void Buffer::append(const char *data, size_t len)
+{
+    makeSpace(len);
+    memcpy(beginWrite(), data, len);
+    writer_index += len;
+}
+
+void Buffer::makeSpace(size_t len)
+{
+    if (writableBytes() >= len)
+        return;
+
+    size_t readable = readableBytes();
+    if (reader_index + writableBytes() >= len)
+    {
+        // 已读空间足够, 把可读数据搬到头部
+        memmove(begin(), peek(), readable);
+        reader_index = 0;
+        writer_index = readable;
+    }
+    else
+    {
+        buffer.resize(writer_index + len);
+    }
+}
+
+ssize_t Buffer::readFd(int fd, int *saved_errno)
+{
+    // 缓冲区剩余空间不足时, 多出的数据先读到栈上再追加, 保证一次readv读完内核中的数据
+    char extra[EXTRA_READ_SIZE];
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+
+    vec[0].iov_base = beginWrite();
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extra;
+    vec[1].iov_len = sizeof(extra);
+
+    // 可写空间已经足够大时不使用栈上空间
+    const int iovcnt = (writable < sizeof(extra)) ? 2 : 1;
+    const ssize_t n = readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saved_errno = errno;
+    }
+    else if (static_cast<size_t>(n) <= writable)
+    {
+        writer_index += n;
+    }
+    else
+    {
+        writer_index = buffer.size();
+        append(extra, n - writable);
+    }
+    return n;
+}
\ No newline at end of file
@@ -0,0 +1,395 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 18:40:44
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 18:40:44
+ * @FilePath: /WebServerByCPP/src/CgiSpawner.cpp
+ * @Description: CGI辅助进程实现
+ * 消息格式为脚本路径和若干"名称=值"环境变量, 各以'\0'结尾, 控制消息中依次是脚本的标准输入、标准输出和发回pidfd的socket
+ * SOCK_SEQPACKET保留消息边界, 多个线程可以同时发送而不必加锁; 服务器一端非阻塞, 队列已满时本次请求直接fork
+ * 辅助进程单线程运行, 忽略SIGCHLD由内核回收脚本进程, 子进程在exec之前恢复默认的信号处理
+ * 收到的fd带close-on-exec, 交出后立即关闭, 之后fork的子进程不会持有其他请求的管道
+ * 发回报告的socket也带close-on-exec: exec成功时随之关闭, exec失败时子进程先发送一条失败消息再退出
+ */
+#include "../include/CgiSpawner.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const size_t MAX_MESSAGE = 65536;    // 一条请求消息的最大长度
+static const size_t MAX_WARM_SCRIPTS = 16;  // 最多为多少个脚本保留等待中的子进程
+static const size_t REQUEST_FDS = 3;        // 请求附带的fd: 标准输入、标准输出、发回pidfd的socket
+
+int CgiSpawner::server_socket = -1;
+std::atomic<bool> CgiSpawner::available(false);
+
+// 等待请求的子进程, 只在辅助进程中使用
+struct WarmChild
+{
+    pid_t pid;
+    int socket; // 辅助进程一端
+};
+
+// 按脚本路径保存的等待中的子进程
+static std::map<std::string, std::deque<WarmChild>> warm_pools;
+
+// 发送一条消息, 附带count个fd(最多REQUEST_FDS个, 可以为0)
+static bool sendWithFds(int socket, const char *data, size_t len, const int *fds, size_t count, int flags)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(data);
+    iov.iov_len = len;
+
+    union
+    {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int) * REQUEST_FDS)];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (count > 0)
+    {
+        msg.msg_control = control.space;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+    }
+
+    ssize_t n;
+    do
+    {
+        n = sendmsg(socket, &msg, flags | MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+    return n == static_cast<ssize_t>(len);
+}
+
+// 接收一条消息和count个fd(带close-on-exec, 最多REQUEST_FDS个); 返回消息长度, 对端关闭时返回0
+// fd_count为nullptr时必须恰好收到count个fd, 否则可以少于count个, 实际数量存入fd_count, 其余位置为-1
+// 出错返回-1, 消息被截断或fd数量不对时关闭收到的fd, errno为EBADMSG
+static ssize_t receiveWithFds(int socket, char *buf, size_t size, int *fds, size_t count, size_t *fd_count = nullptr)
+{
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = size;
+
+    union
+    {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int) * REQUEST_FDS)];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+
+    for (size_t i = 0; i < count; ++i)
+        fds[i] = -1;
+    ssize_t n = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+    if (n <= 0)
+        return n;
+
+    size_t received_total = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        const size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < received; ++i)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (received_total < count)
+                fds[received_total] = fd;
+            else
+                close(fd);
+            ++received_total;
+        }
+    }
+
+    const bool count_ok = fd_count == nullptr ? received_total == count : received_total <= count;
+    if (!count_ok || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (fds[i] != -1)
+                close(fds[i]);
+        }
+        errno = EBADMSG;
+        return -1;
+    }
+    if (fd_count != nullptr)
+        *fd_count = received_total;
+    return n;
+}
+
+// 子进程: 等待一个请求, 发回自己的pidfd, 设置标准输入/输出和环境变量后exec脚本; exec失败时报告给服务器
+[[noreturn]] static void childMain(int socket)
+{
+    std::signal(SIGCHLD, SIG_DFL);
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    std::signal(SIGPIPE, SIG_DFL);
+
+    char *buf = static_cast<char *>(malloc(MAX_MESSAGE));
+    int fds[REQUEST_FDS];
+    ssize_t n;
+    do
+    {
+        n = receiveWithFds(socket, buf, MAX_MESSAGE - 1, fds, REQUEST_FDS);
+    } while (n == -1 && errno == EINTR);
+
+    // 辅助进程已退出
+    if (n <= 0)
+        _exit(0);
+    buf[n] = '\0';
+
+    // 本进程不是服务器的子进程, pid可能在退出后被复用, 只有pidfd能可靠地指向它; 服务器用它终止超时的脚本
+    // 报告中同时带上pid, 取不到pidfd时服务器只能按pid终止脚本, 但不会放弃运行时限
+    char report[1 + sizeof(pid_t)];
+    const pid_t pid = getpid();
+    report[0] = 'p';
+    memcpy(report + 1, &pid, sizeof(pid));
+    int self = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    sendWithFds(fds[2], report, sizeof(report), &self, self != -1 ? 1 : 0, MSG_DONTWAIT);
+
+    // dup2得到的fd不带close-on-exec, 收到的原fd和socket在exec时关闭
+    dup2(fds[0], STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+
+    // 环境变量就是消息中的全部条目, 不继承辅助进程的环境
+    char *path = buf;
+    size_t count = 0;
+    for (char *entry = buf + strlen(buf) + 1; entry < buf + n; entry += strlen(entry) + 1)
+        ++count;
+    char **envp = static_cast<char **>(malloc((count + 1) * sizeof(char *)));
+    count = 0;
+    for (char *entry = buf + strlen(buf) + 1; entry < buf + n; entry += strlen(entry) + 1)
+        envp[count++] = entry;
+    envp[count] = nullptr;
+
+    char *argv[] = {path, nullptr};
+    execve(path, argv, envp);
+
+    // 脚本不存在、不可执行或解释器缺失; 服务器读到输出的EOF后看到这条消息, 返回500而不是空的200
+    std::cerr << "启动CGI脚本失败: " << path << ": " << strerror(errno) << '\n';
+    sendWithFds(fds[2], "e", 1, nullptr, 0, MSG_DONTWAIT);
+    _exit(127);
+}
+
+// fork一个等待请求的子进程, 失败时pid为-1
+static WarmChild forkChild(int server_socket)
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == -1)
+        return WarmChild{-1, -1};
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(pair[0]);
+        close(pair[1]);
+        return WarmChild{-1, -1};
+    }
+
+    if (pid == 0)
+    {
+        // 不持有服务器和其他子进程的socket, 它们的对端关闭时能及时看到
+        close(server_socket);
+        for (const auto &pool : warm_pools)
+        {
+            for (const auto &child : pool.second)
+                close(child.socket);
+        }
+        close(pair[0]);
+        childMain(pair[1]);
+    }
+
+    close(pair[1]);
+    return WarmChild{pid, pair[0]};
+}
+
+void CgiSpawner::run(int socket, int warm_per_script)
+{
+    // 脚本进程由内核自动回收; SIGINT/SIGTERM由服务器处理, 辅助进程在服务器关闭socket后退出
+    std::signal(SIGCHLD, SIG_IGN);
+    std::signal(SIGINT, SIG_IGN);
+    std::signal(SIGTERM, SIG_IGN);
+
+    const size_t warm = warm_per_script > 0 ? static_cast<size_t>(warm_per_script) : 0;
+    char *buf = static_cast<char *>(malloc(MAX_MESSAGE));
+    while (true)
+    {
+        int fds[REQUEST_FDS];
+        ssize_t n = receiveWithFds(socket, buf, MAX_MESSAGE, fds, REQUEST_FDS);
+        if (n == 0)
+            break;
+        if (n < 0)
+        {
+            if (errno == EINTR || errno == EBADMSG)
+                continue;
+            std::cerr << "CGI辅助进程接收请求失败: " << strerror(errno) << '\n';
+            break;
+        }
+
+        const std::string path(buf, strnlen(buf, static_cast<size_t>(n)));
+        auto pool = warm_pools.find(path);
+        if (pool == warm_pools.end() && warm > 0 && warm_pools.size() < MAX_WARM_SCRIPTS)
+            pool = warm_pools.emplace(path, std::deque<WarmChild>()).first;
+
+        // 交给等待中的子进程; 子进程意外退出时发送失败, 换下一个; 都没有时当场fork
+        bool delivered = false;
+        while (!delivered && pool != warm_pools.end() && !pool->second.empty())
+        {
+            WarmChild child = pool->second.front();
+            pool->second.pop_front();
+            delivered = sendWithFds(child.socket, buf, static_cast<size_t>(n), fds, REQUEST_FDS, 0);
+            close(child.socket);
+        }
+        if (!delivered)
+        {
+            WarmChild child = forkChild(socket);
+            if (child.pid != -1)
+            {
+                delivered = sendWithFds(child.socket, buf, static_cast<size_t>(n), fds, REQUEST_FDS, 0);
+                close(child.socket);
+            }
+        }
+        if (!delivered)
+            std::cerr << "CGI辅助进程无法启动脚本: " << path << '\n';
+
+        // 脚本已持有管道, 关闭本进程的副本; 服务器在脚本无法启动时读到EOF
+        for (int fd : fds)
+            close(fd);
+
+        // 交出请求之后再补充等待中的子进程, fork不在本次请求的路径上
+        while (pool != warm_pools.end() && pool->second.size() < warm)
+        {
+            WarmChild child = forkChild(socket);
+            if (child.pid == -1)
+                break;
+            pool->second.push_back(child);
+        }
+    }
+
+    // 服务器已退出: 关闭所有等待中的子进程的socket, 它们收到EOF后退出
+    for (const auto &pool : warm_pools)
+    {
+        for (const auto &child : pool.second)
+            close(child.socket);
+    }
+    _exit(0);
+}
+
+bool CgiSpawner::start(int warm_per_script)
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == -1)
+    {
+        std::cerr << "创建CGI辅助进程socket失败: " << strerror(errno) << '\n';
+        return false;
+    }
+
+    // 避免缓冲区中尚未输出的内容被子进程重复输出
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "创建CGI辅助进程失败: " << strerror(errno) << '\n';
+        close(pair[0]);
+        close(pair[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        close(pair[0]);
+        run(pair[1], warm_per_script);
+    }
+
+    close(pair[1]);
+    server_socket = pair[0];
+    available.store(true, std::memory_order_relaxed);
+    std::cout << "CGI辅助进程 " << pid << " 已启动 (每个脚本预先fork的进程数: " << warm_per_script << ")" << '\n';
+    return true;
+}
+
+bool CgiSpawner::spawn(const std::string &path, const std::vector<std::string> &env, int stdin_fd, int stdout_fd,
+                       int report_fd)
+{
+    if (!available.load(std::memory_order_relaxed))
+        return false;
+
+    std::string message(path);
+    message += '\0';
+    for (const auto &item : env)
+    {
+        message += item;
+        message += '\0';
+    }
+    if (message.size() >= MAX_MESSAGE)
+        return false;
+
+    const int fds[REQUEST_FDS] = {stdin_fd, stdout_fd, report_fd};
+    if (sendWithFds(server_socket, message.data(), message.size(), fds, REQUEST_FDS, MSG_DONTWAIT))
+        return true;
+
+    // 队列暂时已满时本次直接fork; 辅助进程已退出时不再使用
+    if (errno != EAGAIN && errno != EWOULDBLOCK && available.exchange(false))
+        std::cerr << "CGI辅助进程不可用(" << strerror(errno) << "), 改为直接fork" << '\n';
+    return false;
+}
+
+CgiSpawner::Launch CgiSpawner::receiveReport(int socket, pid_t &pid, int &pid_fd)
+{
+    Launch state = pid != -1 ? Launch::Started : Launch::Pending;
+    while (state != Launch::Failed)
+    {
+        char report[1 + sizeof(pid_t)];
+        int fd;
+        size_t fd_count = 0;
+        ssize_t n = receiveWithFds(socket, report, sizeof(report), &fd, 1, &fd_count);
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        // 各端都已关闭: 脚本已exec或子进程已退出; 没有收到过报告说明请求没有交给任何子进程
+        if (n == 0)
+            return state == Launch::Pending ? Launch::Failed : state;
+        if (n < 0)
+            return state;
+
+        if (report[0] == 'p' && n == static_cast<ssize_t>(sizeof(report)))
+        {
+            state = Launch::Started;
+            memcpy(&pid, report + 1, sizeof(pid));
+            if (fd_count == 1 && pid_fd == -1)
+                pid_fd = fd;
+            else if (fd_count == 1)
+                close(fd);
+        }
+        else
+        {
+            state = Launch::Failed;
+            if (fd_count == 1)
+                close(fd);
+        }
+    }
+    return state;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 16:55:31
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 16:55:31
+ * @FilePath: /WebServerByCPP/src/CoDel.cpp
+ * @Description: CoDel丢弃决定的实现, 按RFC 8289的出队逻辑, 每次出队只对当前任务作一次决定
+ * 重新进入丢弃状态时, 如果距上次丢弃不久, 从上次的丢弃次数继续, 尽快恢复到之前的丢弃速率
+ */
+#include "../include/CoDel.h"
+#include <cmath>
+
+CoDel::CoDel(Clock::duration target, Clock::duration interval)
+    : target(target), interval(interval), mutex(), engaged(false), dropping(false), first_above(), drop_next(),
+      count(0), last_count(0)
+{
+}
+
+CoDel::Clock::time_point CoDel::controlLaw(Clock::time_point t) const
+{
+    auto step = std::chrono::duration_cast<Clock::duration>(interval / std::sqrt(static_cast<double>(count)));
+    return t + step;
+}
+
+bool CoDel::shouldDrop(Clock::duration sojourn, Clock::time_point now)
+{
+    // 快速路径: 排队时间正常且没有处于观察或丢弃状态
+    if (sojourn < target && !engaged.load(std::memory_order_relaxed))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 排队时间在整个观察窗口内都高于目标值时才允许丢弃
+    bool ok_to_drop = false;
+    if (sojourn < target)
+    {
+        first_above = Clock::time_point();
+    }
+    else if (first_above == Clock::time_point())
+    {
+        first_above = now + interval;
+    }
+    else if (now >= first_above)
+    {
+        ok_to_drop = true;
+    }
+
+    bool drop = false;
+    if (dropping)
+    {
+        if (!ok_to_drop)
+        {
+            // 排队时间已回落, 离开丢弃状态
+            dropping = false;
+        }
+        else if (now >= drop_next)
+        {
+            ++count;
+            drop_next = controlLaw(drop_next);
+            drop = true;
+        }
+    }
+    else if (ok_to_drop)
+    {
+        dropping = true;
+        // 距上次丢弃状态不久又出现积压, 说明之前的丢弃速率更合适
+        uint32_t delta = count - last_count;
+        count = (delta > 1 && now - drop_next < interval * 16) ? delta : 1;
+        drop_next = controlLaw(now);
+        last_count = count;
+        drop = true;
+    }
+
+    engaged.store(dropping || first_above != Clock::time_point(), std::memory_order_relaxed);
+    return drop;
+}
\ No newline at end of file
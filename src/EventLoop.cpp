@@ -0,0 +1,645 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 09:20:13
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 09:20:13
+ * @FilePath: /WebServerByCPP/src/EventLoop.cpp
+ * @Description: epoll事件循环实现, 负责等待fd就绪事件并调用对应回调
+ * 使用eventfd唤醒循环以执行其他线程投递的任务, 回调在事件处理期间被移除时延迟析构, 避免自毁
+ * 定时器保存在分层时间轮中, timerfd每个tick触发一次, 按经过的实际时间推进时间轮, 时间轮为空时停止触发
+ * io_uring后端中每个请求的user_data由操作类型、请求标识和fd组成, fd移除后(即使fd号已被复用)旧请求的完成事件按标识丢弃
+ */
+#include "../include/EventLoop.h"
+#include "../include/IoUring.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// io_uring请求的操作类型, 保存在user_data的最高字节
+enum : uint64_t
+{
+    OP_POLL = 1,
+    OP_RECV = 2,
+    OP_ACCEPT = 3,
+    OP_CANCEL = 4
+};
+
+static constexpr uint16_t RECV_BUFFER_GROUP = 0; // 接收缓冲区组号
+
+static uint64_t makeUserData(uint64_t op, uint32_t token, int fd)
+{
+    return op << 56 | static_cast<uint64_t>(token & 0xFFFFFF) << 32 | static_cast<uint32_t>(fd);
+}
+
+EventLoop::EventLoop(Backend backend)
+    : epoll_fd(-1), ring(), next_token(0), recv_buffers_failed(false), wakeup_fd(-1), quitting(false), thread_id(),
+      calling_pending_functors(false), pending_queue(PENDING_QUEUE_SIZE), running_functors(), pending_functors(),
+      overflow_count(0), timer_fd(-1), timer_running(false), timer_epoch(Clock::now()), timer_wheel()
+{
+    if (backend == Backend::IO_URING)
+    {
+        try
+        {
+            ring.reset(new IoUring(URING_ENTRIES));
+        }
+        catch (const std::exception &e)
+        {
+            // 每个循环都会尝试, 只提示一次
+            static std::once_flag warned;
+            std::call_once(warned, [&e] { std::cerr << e.what() << ", 使用epoll后端" << '\n'; });
+        }
+    }
+
+    if (!ring)
+    {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd == -1)
+        {
+            throw std::runtime_error("创建epoll实例失败");
+        }
+    }
+
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd == -1)
+    {
+        if (epoll_fd != -1)
+            close(epoll_fd);
+        throw std::runtime_error("创建eventfd失败");
+    }
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1)
+    {
+        close(wakeup_fd);
+        if (epoll_fd != -1)
+            close(epoll_fd);
+        throw std::runtime_error("创建timerfd失败");
+    }
+
+    if (ring)
+    {
+        // 唤醒和定时器的poll请求始终存在, 不会被取消
+        armPoll(wakeup_fd, EPOLLIN, 0);
+        armPoll(timer_fd, EPOLLIN, 0);
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeup_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) == -1)
+    {
+        close(timer_fd);
+        close(wakeup_fd);
+        close(epoll_fd);
+        throw std::runtime_error("注册eventfd失败");
+    }
+
+    ev.data.fd = timer_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev) == -1)
+    {
+        close(timer_fd);
+        close(wakeup_fd);
+        close(epoll_fd);
+        throw std::runtime_error("注册timerfd失败");
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    // 先释放回调(其中可能持有连接对象), 连接析构时会关闭各自的fd
+    registrations.clear();
+    dead_registrations.clear();
+    ring.reset();
+    close(timer_fd);
+    close(wakeup_fd);
+    if (epoll_fd != -1)
+        close(epoll_fd);
+}
+
+void EventLoop::loop()
+{
+    thread_id = std::this_thread::get_id();
+    if (ring)
+        runUring();
+    else
+        runEpoll();
+}
+
+void EventLoop::runEpoll()
+{
+    std::vector<struct epoll_event> events(MAX_EVENTS);
+
+    while (!quitting)
+    {
+        int n = epoll_wait(epoll_fd, events.data(), MAX_EVENTS, -1);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "epoll_wait失败: " << strerror(errno) << '\n';
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == wakeup_fd)
+            {
+                handleWakeup();
+                continue;
+            }
+            if (fd == timer_fd)
+            {
+                handleTimers();
+                continue;
+            }
+
+            // 前面的回调可能已经移除了这个fd
+            auto it = registrations.find(fd);
+            if (it != registrations.end())
+            {
+                it->second.on_event(events[i].events);
+            }
+        }
+
+        releaseDeadCallbacks();
+        doPendingFunctors();
+    }
+}
+
+void EventLoop::runUring()
+{
+    ring->registerRingFd();
+    while (!quitting)
+    {
+        // 一次系统调用提交上一轮排队的全部请求(注册、取消、重新提交), 并等待新的完成事件
+        int ret = ring->submitAndWait(1);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY)
+        {
+            std::cerr << "io_uring_enter失败: " << strerror(-ret) << '\n';
+            break;
+        }
+
+        struct io_uring_cqe cqe;
+        while (ring->popCompletion(cqe))
+        {
+            handleCompletion(cqe);
+        }
+
+        releaseDeadCallbacks();
+        doPendingFunctors();
+    }
+}
+
+uint32_t EventLoop::nextToken()
+{
+    next_token = (next_token + 1) & 0xFFFFFF;
+    if (next_token == 0)
+        next_token = 1;
+    return next_token;
+}
+
+void EventLoop::armPoll(int fd, uint32_t events, uint32_t token)
+{
+    // 多次poll: 一次提交, 每次就绪都产生完成事件, 与边缘触发的语义一致
+    struct io_uring_sqe *sqe = ring->getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = makeUserData(OP_POLL, token, fd);
+}
+
+void EventLoop::armRecv(int fd, uint32_t token)
+{
+    // 多次recv: 数据到达时由内核从缓冲区环中取一个缓冲区读入, 不再需要就绪通知和readv
+    struct io_uring_sqe *sqe = ring->getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = ring->bufferGroup();
+    sqe->user_data = makeUserData(OP_RECV, token, fd);
+}
+
+void EventLoop::armAccept(int fd, uint32_t token)
+{
+    // 多次accept: 每个新连接一个完成事件, 多个进程共享监听socket时内核只唤醒其中一个
+    struct io_uring_sqe *sqe = ring->getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = makeUserData(OP_ACCEPT, token, fd);
+}
+
+void EventLoop::cancelRequest(uint64_t user_data)
+{
+    // 按user_data取消, 调用者随后会关闭fd, 不能按fd取消; 成功时不产生完成事件
+    struct io_uring_sqe *sqe = ring->getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = makeUserData(OP_CANCEL, 0, 0);
+}
+
+bool EventLoop::ensureRecvBuffers()
+{
+    if (ring->hasBufferRing())
+        return true;
+    if (recv_buffers_failed)
+        return false;
+
+    if (!ring->setupBufferRing(RECV_BUFFER_GROUP, RECV_BUFFER_COUNT, RECV_BUFFER_SIZE))
+    {
+        std::cerr << "注册io_uring接收缓冲区失败, 改用就绪事件读取" << '\n';
+        recv_buffers_failed = true;
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::handleCompletion(const struct io_uring_cqe &cqe)
+{
+    const uint64_t op = cqe.user_data >> 56;
+    const uint32_t token = (cqe.user_data >> 32) & 0xFFFFFF;
+    const int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+    const bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+    if (op == OP_CANCEL)
+        return; // 要取消的请求已经结束
+
+    if (op == OP_POLL && (fd == wakeup_fd || fd == timer_fd))
+    {
+        if (fd == wakeup_fd)
+            handleWakeup();
+        else
+            handleTimers();
+        if (!more)
+            armPoll(fd, EPOLLIN, 0);
+        return;
+    }
+
+    auto it = registrations.find(fd);
+
+    if (op == OP_POLL)
+    {
+        // fd已移除或请求已被替换
+        if (it == registrations.end() || it->second.poll_token != token)
+            return;
+
+        if (cqe.res > 0)
+            it->second.on_event(static_cast<uint32_t>(cqe.res));
+        else if (cqe.res < 0 && cqe.res != -ECANCELED)
+            it->second.on_event(EPOLLERR);
+
+        // 多次poll因完成队列溢出等原因结束时重新提交
+        it = registrations.find(fd);
+        if (!more && cqe.res >= 0 && it != registrations.end() && it->second.poll_token == token)
+            armPoll(fd, it->second.poll_events, token);
+        return;
+    }
+
+    const bool current = it != registrations.end() && it->second.io_token == token;
+
+    if (op == OP_RECV)
+    {
+        if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            // 数据在回调中复制到连接的输入缓冲区, 返回后立即归还缓冲区
+            uint16_t id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            if (current && cqe.res > 0)
+                it->second.on_data(ring->bufferAddress(id), cqe.res);
+            ring->recycleBuffer(id);
+        }
+        else if (current && cqe.res != -ENOBUFS)
+        {
+            it->second.on_data(nullptr, cqe.res); // 对端关闭或出错
+        }
+
+        // 缓冲区暂时用尽等原因结束时重新提交; 对端关闭和出错时不再提交
+        it = registrations.find(fd);
+        if (!more && (cqe.res > 0 || cqe.res == -ENOBUFS) && it != registrations.end() && it->second.io_token == token)
+            armRecv(fd, token);
+        return;
+    }
+
+    if (op == OP_ACCEPT)
+    {
+        if (cqe.res >= 0)
+        {
+            // 监听socket已移除, 新连接没有人接管
+            if (current)
+                it->second.on_accept(cqe.res);
+            else
+                close(cqe.res);
+        }
+        else if (current && cqe.res == -EINVAL)
+        {
+            // 内核不支持多次accept, 改为就绪事件+accept4
+            it->second.on_accept = AcceptCallback();
+            it->second.io_token = 0;
+            it->second.poll_token = nextToken();
+            armPoll(fd, it->second.poll_events, it->second.poll_token);
+            return;
+        }
+        else if (current && cqe.res != -ECANCELED)
+        {
+            std::cerr << "接受客户端连接失败: " << strerror(-cqe.res) << '\n';
+        }
+
+        it = registrations.find(fd);
+        if (more || it == registrations.end() || it->second.io_token != token)
+            return;
+
+        // 出错(例如fd耗尽)时稍后再提交, 避免立即失败的请求反复提交
+        if (cqe.res >= 0)
+        {
+            armAccept(fd, token);
+        }
+        else
+        {
+            runAfter(ACCEPT_RETRY_MS, [this, fd, token] {
+                auto retry = registrations.find(fd);
+                if (retry != registrations.end() && retry->second.io_token == token)
+                    armAccept(fd, token);
+            });
+        }
+    }
+}
+
+void EventLoop::quit()
+{
+    quitting = true;
+    wakeup();
+}
+
+void EventLoop::runInLoop(Functor cb)
+{
+    if (isInLoopThread())
+    {
+        cb();
+    }
+    else
+    {
+        queueInLoop(std::move(cb));
+    }
+}
+
+void EventLoop::queueInLoop(Functor cb)
+{
+    // 溢出列表非空时不再进入无锁队列, 保证同一线程投递的任务按顺序执行
+    bool queued = overflow_count.load(std::memory_order_acquire) == 0 && pending_queue.tryPush(std::move(cb));
+    if (!queued)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_functors.push_back(std::move(cb));
+        overflow_count.store(pending_functors.size(), std::memory_order_release);
+    }
+
+    // 非循环线程投递, 或循环线程正在执行任务时又投递了新任务, 都需要唤醒以免任务滞留
+    if (!isInLoopThread() || calling_pending_functors)
+    {
+        wakeup();
+    }
+}
+
+void EventLoop::addFd(int fd, uint32_t events, EventCallback cb, DataCallback on_data)
+{
+    Registration reg{std::move(cb), DataCallback(), AcceptCallback(), events, 0, 0};
+
+    if (ring)
+    {
+        // 多次poll不支持EPOLLEXCLUSIVE; 由recv读取数据时poll只关心可写和错误
+        reg.poll_events = events & ~static_cast<uint32_t>(EPOLLEXCLUSIVE);
+        if (on_data && ensureRecvBuffers())
+        {
+            reg.on_data = std::move(on_data);
+            reg.io_token = nextToken();
+            reg.poll_events &= ~static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP);
+            armRecv(fd, reg.io_token);
+        }
+        reg.poll_token = nextToken();
+        armPoll(fd, reg.poll_events, reg.poll_token);
+        registrations[fd] = std::move(reg);
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        throw std::runtime_error(std::string("epoll_ctl ADD失败: ") + strerror(errno));
+    }
+    registrations[fd] = std::move(reg);
+}
+
+void EventLoop::addListener(int fd, uint32_t events, EventCallback cb, AcceptCallback on_accept)
+{
+    if (!ring)
+    {
+        addFd(fd, events, std::move(cb));
+        return;
+    }
+
+    // 保留就绪回调和事件, 内核不支持多次accept时退回使用
+    Registration reg{std::move(cb), DataCallback(), std::move(on_accept),
+                     events & ~static_cast<uint32_t>(EPOLLEXCLUSIVE), 0, nextToken()};
+    armAccept(fd, reg.io_token);
+    registrations[fd] = std::move(reg);
+}
+
+void EventLoop::modFd(int fd, uint32_t events)
+{
+    if (ring)
+    {
+        auto it = registrations.find(fd);
+        if (it == registrations.end())
+            return;
+
+        // 替换poll请求: 取消旧的, 以新的标识提交
+        Registration &reg = it->second;
+        reg.poll_events = events & ~static_cast<uint32_t>(EPOLLEXCLUSIVE);
+        if (reg.on_data)
+            reg.poll_events &= ~static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP);
+        if (reg.poll_token != 0)
+            cancelRequest(makeUserData(OP_POLL, reg.poll_token, fd));
+        reg.poll_token = nextToken();
+        armPoll(fd, reg.poll_events, reg.poll_token);
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1)
+    {
+        std::cerr << "epoll_ctl MOD失败: " << strerror(errno) << '\n';
+    }
+}
+
+void EventLoop::removeFd(int fd)
+{
+    auto it = registrations.find(fd);
+
+    if (ring)
+    {
+        // 取消请求随下一次io_uring_enter提交; 之后到达的完成事件因标识不匹配而被丢弃
+        if (it != registrations.end())
+        {
+            if (it->second.poll_token != 0)
+                cancelRequest(makeUserData(OP_POLL, it->second.poll_token, fd));
+            if (it->second.io_token != 0)
+                cancelRequest(makeUserData(it->second.on_accept ? OP_ACCEPT : OP_RECV, it->second.io_token, fd));
+        }
+    }
+    else
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    if (it != registrations.end())
+    {
+        // 调用者可能正处于该回调内部, 不能立即析构
+        dead_registrations.push_back(std::move(it->second));
+        registrations.erase(it);
+    }
+}
+
+uint64_t EventLoop::nowTick() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - timer_epoch);
+    return static_cast<uint64_t>(elapsed.count() / TIMER_TICK_MS);
+}
+
+EventLoop::TimerId EventLoop::runAfter(int64_t milliseconds, Functor cb)
+{
+    // 到期的定时器只在timerfd触发时执行: 调用者可能正处于其他回调或协程挂起的中间, 这里不能执行任何回调
+    // 时间轮为空时直接对齐到当前时间(不会执行回调); 否则按时间轮落后的tick数补上, 使期限从现在算起
+    const uint64_t now = nowTick();
+    if (timer_wheel.empty())
+        timer_wheel.advanceTo(now);
+    const uint64_t lag = now > timer_wheel.currentTick() ? now - timer_wheel.currentTick() : 0;
+
+    // 当前tick已经过去了一部分, 多加一个tick保证不会提前触发
+    uint64_t ticks = milliseconds > 0 ? (milliseconds + TIMER_TICK_MS - 1) / TIMER_TICK_MS + 1 : 1;
+    TimerId id = timer_wheel.add(ticks + lag, std::move(cb));
+
+    if (!timer_running)
+    {
+        setTimerRunning(true);
+    }
+    return id;
+}
+
+void EventLoop::cancelTimer(TimerId id)
+{
+    // 时间轮变空时不立即停止timerfd, 下一次触发时再停止, 避免频繁地启停
+    timer_wheel.cancel(id);
+}
+
+void EventLoop::handleTimers()
+{
+    uint64_t expirations = 0;
+    ssize_t n = read(timer_fd, &expirations, sizeof(expirations));
+    (void)n;
+
+    // 按实际经过的时间推进, 不依赖触发次数; 同一tick到期的定时器集中执行
+    timer_wheel.advanceTo(nowTick());
+
+    if (timer_wheel.empty())
+    {
+        setTimerRunning(false);
+    }
+}
+
+void EventLoop::setTimerRunning(bool running)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    // 全零表示停止timerfd
+    if (running)
+    {
+        spec.it_value.tv_sec = TIMER_TICK_MS / 1000;
+        spec.it_value.tv_nsec = (TIMER_TICK_MS % 1000) * 1000000;
+        spec.it_interval = spec.it_value;
+    }
+
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+    timer_running = running;
+}
+
+void EventLoop::wakeup()
+{
+    uint64_t one = 1;
+    ssize_t n = write(wakeup_fd, &one, sizeof(one));
+    (void)n; // 计数器溢出时write会失败, 但此时循环必然已被唤醒
+}
+
+void EventLoop::handleWakeup()
+{
+    uint64_t count = 0;
+    ssize_t n = read(wakeup_fd, &count, sizeof(count));
+    (void)n;
+}
+
+void EventLoop::doPendingFunctors()
+{
+    calling_pending_functors = true;
+
+    // 先全部取出再执行, 任务执行期间新投递的任务留到下一轮; 先取无锁队列, 再取溢出列表
+    std::vector<Functor> functors;
+    functors.swap(running_functors);
+    size_t count = 0;
+    do
+    {
+        functors.resize(count + PENDING_BATCH);
+        count += pending_queue.popBatch(functors.data() + count, PENDING_BATCH);
+    } while (functors.size() == count);
+    functors.resize(count);
+
+    if (overflow_count.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Functor &functor : pending_functors)
+        {
+            functors.push_back(std::move(functor));
+        }
+        pending_functors.clear();
+        overflow_count.store(0, std::memory_order_release);
+    }
+
+    for (const Functor &functor : functors)
+    {
+        functor();
+    }
+
+    // 保留容量供下一轮使用
+    functors.clear();
+    running_functors.swap(functors);
+
+    // 任务中移除的回调同样需要在这里释放
+    releaseDeadCallbacks();
+    calling_pending_functors = false;
+}
+
+void EventLoop::releaseDeadCallbacks()
+{
+    // 先换出再析构, 回调析构时(例如连接对象被释放)可能再次调用removeFd
+    std::vector<Registration> dead;
+    dead.swap(dead_registrations);
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 15:40:25
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 15:40:25
+ * @FilePath: /WebServerByCPP/src/Executor.cpp
+ * @Description: 协程执行器实现, 任务通过queueInLoop投递到循环线程, 以spawnTask启动
+ * 任务结束时若等待队列不为空, 直接把名额转给队首任务, 运行数不变
+ */
+#include "../include/Executor.h"
+#include <iostream>
+
+Executor::Executor(size_t thread_count, size_t max_active, size_t max_queue, EventLoop::Backend backend)
+    : next_loop(0), max_active(max_active > 0 ? max_active : 1), max_queue(max_queue), active(0), active_count(0),
+      queued_count(0), completed_count(0), rejected_count(0), stopping(false)
+{
+    if (thread_count < 1)
+        thread_count = 1;
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        loops.emplace_back(new EventLoop(backend));
+    }
+}
+
+Executor::~Executor()
+{
+    stop();
+}
+
+void Executor::start()
+{
+    for (auto &loop : loops)
+    {
+        EventLoop *raw = loop.get();
+        threads.emplace_back([raw] { raw->loop(); });
+    }
+}
+
+void Executor::stop()
+{
+    if (stopping.exchange(true))
+        return;
+
+    for (auto &loop : loops)
+    {
+        loop->quit();
+    }
+    for (auto &thread : threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+    queued_count.store(0, std::memory_order_relaxed);
+}
+
+bool Executor::trySpawn(TaskFactory factory)
+{
+    if (stopping.load(std::memory_order_relaxed))
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active >= max_active)
+        {
+            if (pending.size() >= max_queue)
+            {
+                rejected_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            pending.push_back(std::move(factory));
+            queued_count.store(pending.size(), std::memory_order_relaxed);
+            return true;
+        }
+        ++active;
+        active_count.store(active, std::memory_order_relaxed);
+    }
+
+    launch(std::move(factory));
+    return true;
+}
+
+void Executor::launch(TaskFactory factory)
+{
+    EventLoop *loop = loops[next_loop.fetch_add(1, std::memory_order_relaxed) % loops.size()].get();
+    loop->queueInLoop([this, loop, factory = std::move(factory)]() mutable {
+        spawnTask(run(*loop, std::move(factory)));
+    });
+}
+
+Task<void> Executor::run(EventLoop &loop, TaskFactory factory)
+{
+    try
+    {
+        co_await factory(loop);
+    }
+    catch (const std::exception &e)
+    {
+        // 任务自身应处理异常, 这里只保证名额被归还
+        std::cerr << "执行器任务异常: " << e.what() << '\n';
+    }
+    finish();
+}
+
+void Executor::finish()
+{
+    completed_count.fetch_add(1, std::memory_order_relaxed);
+
+    TaskFactory next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty())
+        {
+            --active;
+            active_count.store(active, std::memory_order_relaxed);
+            return;
+        }
+        next = std::move(pending.front());
+        pending.pop_front();
+        queued_count.store(pending.size(), std::memory_order_relaxed);
+    }
+    launch(std::move(next));
+}
\ No newline at end of file
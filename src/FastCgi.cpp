@@ -0,0 +1,778 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 17:40:12
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 17:40:12
+ * @FilePath: /WebServerByCPP/src/FastCgi.cpp
+ * @Description: FastCGI客户端实现: 路由解析、记录编码、每个执行器线程的连接池和按请求ID复用的连接
+ * 每个连接有一个读协程, 持续读取记录并按请求ID分发到等待中的请求; 写入由一个写协程串行完成, 多个请求的记录不会交错
+ * 读写协程在同一个事件循环上分别等待可读和可写, 因此写入使用dup出的另一个fd注册
+ * 连接出错、被后端关闭、请求超时或输出超出上限时关闭读写两个方向, 读协程随之结束并让该连接上所有未完成的请求返回502
+ * 等待中的请求在事件循环的下一轮恢复, 不在读协程内部嵌套执行
+ * 请求的时限从进入fastCgiRequest开始计算, 建立连接和等待空闲连接也受它限制, 后端无响应或连接池被占满时同样返回504
+ */
+#include "../include/FastCgi.h"
+#include "../include/AsyncIo.h"
+#include "../include/EventLoop.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// 协议常量
+static const uint8_t FCGI_VERSION_1 = 1;
+static const uint8_t FCGI_BEGIN_REQUEST = 1;
+static const uint8_t FCGI_END_REQUEST = 3;
+static const uint8_t FCGI_PARAMS = 4;
+static const uint8_t FCGI_STDIN = 5;
+static const uint8_t FCGI_STDOUT = 6;
+static const uint8_t FCGI_STDERR = 7;
+static const uint8_t FCGI_RESPONDER = 1;
+static const uint8_t FCGI_KEEP_CONN = 1;
+static const uint8_t FCGI_REQUEST_COMPLETE = 0;
+static const uint8_t FCGI_OVERLOADED = 2;
+static const size_t FCGI_HEADER_LEN = 8;
+static const size_t FCGI_MAX_CHUNK = 65528; // 一条记录的最大内容长度(65535)向下取8的倍数
+
+// 去除首尾空白
+static std::string trim(const std::string &text)
+{
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+        return std::string();
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// 解析后端地址: Unix域socket路径(可带"unix:"前缀)或host:port, host在启动时解析为IPv4地址
+static void parseAddress(const std::string &address, FastCgiBackend &backend)
+{
+    backend.address = address;
+    std::string value = address;
+    if (value.compare(0, 5, "unix:") == 0)
+        value = value.substr(5);
+
+    if (!value.empty() && (value[0] == '/' || value[0] == '.'))
+    {
+        if (value.size() >= sizeof(sockaddr_un::sun_path))
+            throw std::runtime_error("FastCGI socket路径过长: " + value);
+        backend.unix_socket = true;
+        backend.unix_path = value;
+        return;
+    }
+
+    size_t colon = value.rfind(':');
+    int port = colon == std::string::npos ? 0 : atoi(value.c_str() + colon + 1);
+    if (colon == std::string::npos || colon == 0 || port <= 0 || port > 65535)
+        throw std::runtime_error("无效的FastCGI后端地址: " + address);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    std::string host = value.substr(0, colon);
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr)
+        throw std::runtime_error("无法解析FastCGI后端地址: " + host);
+
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in *>(result->ai_addr)->sin_addr, ip, sizeof(ip));
+    freeaddrinfo(result);
+
+    backend.unix_socket = false;
+    backend.host = ip;
+    backend.port = static_cast<uint16_t>(port);
+}
+
+std::unique_ptr<FastCgiRoutes> FastCgiRoutes::parse(const std::string &spec, const FastCgiBackend &defaults)
+{
+    std::unique_ptr<FastCgiRoutes> table(new FastCgiRoutes());
+    size_t start = 0;
+    while (start <= spec.size())
+    {
+        size_t comma = spec.find(',', start);
+        if (comma == std::string::npos)
+            comma = spec.size();
+        std::string item = trim(spec.substr(start, comma - start));
+        start = comma + 1;
+        if (item.empty())
+            continue;
+
+        size_t space = item.find_first_of(" \t");
+        if (space == std::string::npos)
+            throw std::runtime_error("FastCGI路由格式应为\"模式 地址\": " + item);
+        std::string pattern = item.substr(0, space);
+        std::string address = trim(item.substr(space));
+
+        // 地址相同的路由共用一个后端, 也就共用连接池
+        const FastCgiBackend *backend = nullptr;
+        for (const auto &existing : table->backends)
+        {
+            if (existing->address == address)
+                backend = existing.get();
+        }
+        if (backend == nullptr)
+        {
+            std::unique_ptr<FastCgiBackend> created(new FastCgiBackend(defaults));
+            parseAddress(address, *created);
+            backend = created.get();
+            table->backends.push_back(std::move(created));
+        }
+        table->routes.push_back(Route{pattern, backend});
+    }
+    return table;
+}
+
+const FastCgiBackend *FastCgiRoutes::match(std::string_view script_name) const
+{
+    for (const auto &route : routes)
+    {
+        bool matched = route.pattern[0] == '.' ? script_name.ends_with(route.pattern)
+                                               : script_name.starts_with(route.pattern);
+        if (matched)
+            return route.backend;
+    }
+    return nullptr;
+}
+
+std::string FastCgiRoutes::describe() const
+{
+    std::string out;
+    for (const auto &route : routes)
+    {
+        if (!out.empty())
+            out += ", ";
+        out += route.pattern + " -> " + route.backend->address;
+    }
+    return out;
+}
+
+void FastCgiParams::appendLength(size_t length)
+{
+    // 小于128的长度用1字节, 否则用最高位置1的4字节
+    if (length < 128)
+    {
+        encoded += static_cast<char>(length);
+        return;
+    }
+    encoded += static_cast<char>(((length >> 24) & 0x7f) | 0x80);
+    encoded += static_cast<char>((length >> 16) & 0xff);
+    encoded += static_cast<char>((length >> 8) & 0xff);
+    encoded += static_cast<char>(length & 0xff);
+}
+
+void FastCgiParams::add(std::string_view name, std::string_view value)
+{
+    appendLength(name.size());
+    appendLength(value.size());
+    encoded.append(name.data(), name.size());
+    encoded.append(value.data(), value.size());
+}
+
+// 追加一条记录, 内容按8字节对齐填充
+static void appendRecord(std::string &out, uint8_t type, uint16_t id, const char *data, size_t len)
+{
+    const size_t padding = (8 - len % 8) % 8;
+    const char header[FCGI_HEADER_LEN] = {
+        static_cast<char>(FCGI_VERSION_1),     static_cast<char>(type),
+        static_cast<char>(id >> 8),            static_cast<char>(id & 0xff),
+        static_cast<char>(len >> 8),           static_cast<char>(len & 0xff),
+        static_cast<char>(padding),            0,
+    };
+    out.append(header, FCGI_HEADER_LEN);
+    out.append(data, len);
+    out.append(padding, '\0');
+}
+
+// 追加一个数据流: 按记录长度上限分段, 最后以空记录结束
+static void appendStream(std::string &out, uint8_t type, uint16_t id, std::string_view data)
+{
+    for (size_t pos = 0; pos < data.size(); pos += FCGI_MAX_CHUNK)
+    {
+        appendRecord(out, type, id, data.data() + pos, std::min(FCGI_MAX_CHUNK, data.size() - pos));
+    }
+    appendRecord(out, type, id, nullptr, 0);
+}
+
+// 等待响应的请求, 位于发起请求的协程帧中
+struct PendingRequest
+{
+    std::string output;
+    int error_status = 0;
+    bool done = false;
+    std::coroutine_handle<> waiter;
+};
+
+// 挂起直到请求完成
+struct ResponseAwaiter
+{
+    PendingRequest &request;
+
+    bool await_ready() const noexcept
+    {
+        return request.done;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        request.waiter = handle;
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+// 标记请求完成, 等待它的协程在事件循环的下一轮恢复
+static void completeRequest(EventLoop &loop, PendingRequest &request)
+{
+    request.done = true;
+    if (request.waiter)
+    {
+        std::coroutine_handle<> waiter = request.waiter;
+        loop.queueInLoop([waiter] { waiter.resume(); });
+    }
+}
+
+class FastCgiPool;
+
+// 到后端的一个连接, 由连接池和使用它的请求共同持有
+class FastCgiConnection : public std::enable_shared_from_this<FastCgiConnection>
+{
+  public:
+    enum class State
+    {
+        CONNECTING,
+        READY,
+        CLOSED
+    };
+
+    FastCgiConnection(EventLoop &loop, FastCgiPool &pool, int fd, int write_fd)
+        : loop(loop), pool(pool), fd(fd), write_fd(write_fd), state(State::CONNECTING), reserved(0), next_id(1),
+          writing(false)
+    {
+    }
+
+    ~FastCgiConnection()
+    {
+        close(write_fd);
+        close(fd);
+    }
+
+    State getState() const
+    {
+        return state;
+    }
+
+    size_t reservedCount() const
+    {
+        return reserved;
+    }
+
+    void reserve()
+    {
+        ++reserved;
+    }
+
+    void unreserve()
+    {
+        --reserved;
+    }
+
+    int getWriteFd() const
+    {
+        return write_fd;
+    }
+
+    // 连接建立后开始读取响应
+    void start()
+    {
+        state = State::READY;
+        spawnTask(readLoop());
+    }
+
+    // 为请求分配ID并排队发送它的全部记录, 返回请求ID
+    uint16_t submit(PendingRequest &request, const FastCgiParams &params, std::string_view body);
+
+    // 请求超时: 该请求返回504, 后端可能已不可用, 关闭连接
+    void timeout(uint16_t id);
+
+    // 输出超出上限: 该请求返回502, 后端仍在发送的输出无法跳过, 关闭连接
+    void overflow(uint16_t id);
+
+    // 关闭读写两个方向, 读协程看到连接结束后清理
+    void abort();
+
+  private:
+    EventLoop &loop;
+    FastCgiPool &pool;
+    int fd;        // 读协程使用
+    int write_fd;  // 写协程使用, 与fd指向同一个socket
+    State state;
+    size_t reserved; // 已分配到该连接上的请求数(包括尚未发送的)
+    uint16_t next_id;
+    std::unordered_map<uint16_t, PendingRequest *> pending; // 已发送、等待响应的请求
+    std::string input;  // 未处理完的响应数据
+    std::string output; // 待发送的记录
+    bool writing;       // 写协程是否在运行
+
+    Task<void> readLoop();
+    Task<void> flush();
+
+    // 处理input中所有完整的记录, 格式错误时返回false
+    bool dispatchRecords();
+
+    // 让所有未完成的请求以status失败
+    void failAll(int status);
+};
+
+// 一个执行器线程到一个后端的连接池, 只在该线程中使用
+class FastCgiPool
+{
+  private:
+    EventLoop &loop;
+    const FastCgiBackend &backend;
+    std::vector<std::shared_ptr<FastCgiConnection>> connections;
+
+    // 挂起直到有请求释放连接、连接被移除或期限到达, 结果为false表示期限已到
+    // 唤醒和期限定时器都在循环线程中执行, 先执行的一方取消另一方, 协程只恢复一次
+    class SlotAwaiter
+    {
+      private:
+        FastCgiPool &pool;
+        std::coroutine_handle<> handle;
+        int64_t timeout_ms;         // 距期限的毫秒数, 小于0表示没有期限
+        EventLoop::TimerId timer;   // 期限定时器, 0表示没有
+        bool expired;               // 期限已到
+
+        friend class FastCgiPool;
+
+      public:
+        SlotAwaiter(FastCgiPool &pool, std::chrono::steady_clock::time_point deadline)
+            : pool(pool), timeout_ms(-1), timer(0), expired(false)
+        {
+            if (deadline != std::chrono::steady_clock::time_point::max())
+            {
+                // 不足1毫秒按1毫秒计, 只有期限已过时才为0
+                auto remaining = deadline - std::chrono::steady_clock::now();
+                timeout_ms = remaining <= remaining.zero()
+                                 ? 0
+                                 : std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+                expired = timeout_ms == 0;
+            }
+        }
+
+        // 期限已过时不挂起
+        bool await_ready() const noexcept
+        {
+            return expired;
+        }
+
+        void await_suspend(std::coroutine_handle<> waiter)
+        {
+            handle = waiter;
+            pool.waiters.push_back(this);
+            if (timeout_ms > 0)
+            {
+                timer = pool.loop.runAfter(timeout_ms, [this] {
+                    timer = 0;
+                    expired = true;
+                    pool.waiters.erase(std::find(pool.waiters.begin(), pool.waiters.end(), this));
+                    handle.resume();
+                });
+            }
+        }
+
+        bool await_resume() const noexcept
+        {
+            return !expired;
+        }
+    };
+
+    std::deque<SlotAwaiter *> waiters; // 等待连接空出的请求, 位于各自的协程帧中
+
+    void wakeWaiter()
+    {
+        if (waiters.empty())
+            return;
+        SlotAwaiter *waiter = waiters.front();
+        waiters.pop_front();
+        if (waiter->timer != 0)
+            loop.cancelTimer(waiter->timer);
+        std::coroutine_handle<> handle = waiter->handle;
+        loop.queueInLoop([handle] { handle.resume(); });
+    }
+
+    // 创建非阻塞socket并发起连接, 失败时返回-1
+    int openSocket(bool &in_progress);
+
+  public:
+    FastCgiPool(EventLoop &loop, const FastCgiBackend &backend) : loop(loop), backend(backend)
+    {
+    }
+
+    const std::string &backendAddress() const
+    {
+        return backend.address;
+    }
+
+    size_t maxOutput() const
+    {
+        return backend.max_output;
+    }
+
+    // 取得一个有空闲请求额度的连接, 必要时新建; 无法连接或到达deadline时返回nullptr, 后者同时置timed_out为true
+    Task<std::shared_ptr<FastCgiConnection>> acquire(std::chrono::steady_clock::time_point deadline, bool &timed_out);
+
+    // 请求完成后归还额度
+    void release(const std::shared_ptr<FastCgiConnection> &conn)
+    {
+        conn->unreserve();
+        wakeWaiter();
+    }
+
+    // 连接关闭后从池中移除
+    void remove(FastCgiConnection *conn)
+    {
+        auto it = std::find_if(connections.begin(), connections.end(),
+                               [conn](const std::shared_ptr<FastCgiConnection> &item) { return item.get() == conn; });
+        if (it != connections.end())
+            connections.erase(it);
+        wakeWaiter();
+    }
+};
+
+uint16_t FastCgiConnection::submit(PendingRequest &request, const FastCgiParams &params, std::string_view body)
+{
+    // 请求ID在连接上唯一, 0保留给管理记录
+    uint16_t id;
+    do
+    {
+        id = next_id++;
+    } while (id == 0 || pending.count(id) != 0);
+    pending[id] = &request;
+
+    const char begin[8] = {0, static_cast<char>(FCGI_RESPONDER), static_cast<char>(FCGI_KEEP_CONN), 0, 0, 0, 0, 0};
+    appendRecord(output, FCGI_BEGIN_REQUEST, id, begin, sizeof(begin));
+    appendStream(output, FCGI_PARAMS, id, params.data());
+    appendStream(output, FCGI_STDIN, id, body);
+
+    if (!writing)
+    {
+        writing = true;
+        spawnTask(flush());
+    }
+    return id;
+}
+
+void FastCgiConnection::timeout(uint16_t id)
+{
+    auto it = pending.find(id);
+    if (it == pending.end())
+        return;
+
+    PendingRequest *request = it->second;
+    pending.erase(it);
+    request->error_status = 504;
+    completeRequest(loop, *request);
+
+    std::cerr << "FastCGI请求超时, 关闭到 " << pool.backendAddress() << " 的连接" << '\n';
+    abort();
+}
+
+void FastCgiConnection::overflow(uint16_t id)
+{
+    auto it = pending.find(id);
+    if (it == pending.end())
+        return;
+
+    PendingRequest *request = it->second;
+    pending.erase(it);
+    request->output.clear();
+    request->error_status = 502;
+    completeRequest(loop, *request);
+
+    std::cerr << "FastCGI应用输出过大, 关闭到 " << pool.backendAddress() << " 的连接" << '\n';
+    abort();
+}
+
+void FastCgiConnection::abort()
+{
+    if (state == State::CLOSED)
+        return;
+    state = State::CLOSED;
+    shutdown(fd, SHUT_RDWR);
+}
+
+void FastCgiConnection::failAll(int status)
+{
+    std::unordered_map<uint16_t, PendingRequest *> failed;
+    failed.swap(pending);
+    for (auto &item : failed)
+    {
+        item.second->error_status = status;
+        completeRequest(loop, *item.second);
+    }
+}
+
+Task<void> FastCgiConnection::flush()
+{
+    auto self = shared_from_this();
+    while (!output.empty() && state == State::READY)
+    {
+        // 发送期间提交的记录追加到新的output中, 下一轮发送
+        std::string chunk;
+        chunk.swap(output);
+        ssize_t n = co_await asyncWrite(loop, write_fd, chunk.data(), chunk.size());
+        if (n < 0)
+        {
+            abort();
+            break;
+        }
+    }
+    output.clear();
+    writing = false;
+}
+
+Task<void> FastCgiConnection::readLoop()
+{
+    auto self = shared_from_this();
+    char buf[16384];
+    while (state == State::READY)
+    {
+        ssize_t n = co_await asyncRead(loop, fd, buf, sizeof(buf));
+        if (n <= 0)
+            break;
+        input.append(buf, static_cast<size_t>(n));
+        if (!dispatchRecords())
+        {
+            std::cerr << "FastCGI响应格式错误: " << pool.backendAddress() << '\n';
+            break;
+        }
+    }
+
+    // 后端关闭了连接或连接出错; 关闭两个方向以唤醒可能在等待可写的写协程
+    abort();
+    failAll(502);
+    pool.remove(this);
+}
+
+bool FastCgiConnection::dispatchRecords()
+{
+    size_t pos = 0;
+    while (state == State::READY && input.size() - pos >= FCGI_HEADER_LEN)
+    {
+        const unsigned char *header = reinterpret_cast<const unsigned char *>(input.data() + pos);
+        if (header[0] != FCGI_VERSION_1)
+            return false;
+
+        const uint8_t type = header[1];
+        const uint16_t id = static_cast<uint16_t>((header[2] << 8) | header[3]);
+        const size_t content_length = (static_cast<size_t>(header[4]) << 8) | header[5];
+        const size_t record_length = FCGI_HEADER_LEN + content_length + header[6];
+        if (input.size() - pos < record_length)
+            break;
+
+        const char *content = input.data() + pos + FCGI_HEADER_LEN;
+        auto it = pending.find(id);
+        if (type == FCGI_STDOUT && it != pending.end())
+        {
+            // 与CGI脚本的cgi_max_output相同, 超出上限时不再缓冲, 关闭连接后剩余的记录不再处理
+            const size_t limit = pool.maxOutput();
+            if (limit > 0 && it->second->output.size() + content_length > limit)
+                overflow(id);
+            else
+                it->second->output.append(content, content_length);
+        }
+        else if (type == FCGI_STDERR && content_length > 0)
+        {
+            std::cerr << "FastCGI错误输出: " << std::string_view(content, content_length) << '\n';
+        }
+        else if (type == FCGI_END_REQUEST && it != pending.end())
+        {
+            // 后端过载时返回503, 其他协议错误(例如不支持复用)返回502
+            PendingRequest *request = it->second;
+            pending.erase(it);
+            uint8_t protocol_status = content_length >= 5 ? static_cast<uint8_t>(content[4]) : FCGI_REQUEST_COMPLETE;
+            if (protocol_status == FCGI_OVERLOADED)
+                request->error_status = 503;
+            else if (protocol_status != FCGI_REQUEST_COMPLETE)
+                request->error_status = 502;
+            completeRequest(loop, *request);
+        }
+        pos += record_length;
+    }
+    input.erase(0, pos);
+    return true;
+}
+
+int FastCgiPool::openSocket(bool &in_progress)
+{
+    int fd;
+    int rc;
+    if (backend.unix_socket)
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+            return -1;
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, backend.unix_path.c_str(), backend.unix_path.size());
+        rc = connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    }
+    else
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1)
+            return -1;
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(backend.port);
+        inet_pton(AF_INET, backend.host.c_str(), &addr.sin_addr);
+        rc = connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    }
+
+    // Unix域socket的监听队列已满时返回EAGAIN, 同样视为后端不可用
+    in_progress = rc == -1 && errno == EINPROGRESS;
+    if (rc == -1 && !in_progress)
+    {
+        std::cerr << "连接FastCGI后端 " << backend.address << " 失败: " << strerror(errno) << '\n';
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+Task<std::shared_ptr<FastCgiConnection>> FastCgiPool::acquire(std::chrono::steady_clock::time_point deadline,
+                                                               bool &timed_out)
+{
+    while (true)
+    {
+        // 优先使用已有连接中负载最轻的一个
+        std::shared_ptr<FastCgiConnection> best;
+        for (const auto &conn : connections)
+        {
+            if (conn->getState() == FastCgiConnection::State::READY &&
+                conn->reservedCount() < backend.max_requests_per_conn &&
+                (best == nullptr || conn->reservedCount() < best->reservedCount()))
+            {
+                best = conn;
+            }
+        }
+        if (best != nullptr)
+        {
+            best->reserve();
+            co_return best;
+        }
+
+        if (connections.size() < backend.max_connections)
+        {
+            bool in_progress = false;
+            int fd = openSocket(in_progress);
+            if (fd == -1)
+                co_return nullptr;
+            int write_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if (write_fd == -1)
+            {
+                close(fd);
+                co_return nullptr;
+            }
+
+            // 连接建立期间占用一个名额, 其他请求不会超出连接数上限
+            auto conn = std::make_shared<FastCgiConnection>(loop, *this, fd, write_fd);
+            conn->reserve();
+            connections.push_back(conn);
+            if (in_progress)
+            {
+                // 后端地址不可达时不等待内核的连接超时, 到期即放弃
+                if (co_await waitWritableUntil(loop, conn->getWriteFd(), deadline) == 0)
+                {
+                    std::cerr << "连接FastCGI后端 " << backend.address << " 超时" << '\n';
+                    remove(conn.get());
+                    timed_out = true;
+                    co_return nullptr;
+                }
+                int error = 0;
+                socklen_t length = sizeof(error);
+                if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0)
+                {
+                    std::cerr << "连接FastCGI后端 " << backend.address << " 失败: " << strerror(error) << '\n';
+                    remove(conn.get());
+                    co_return nullptr;
+                }
+            }
+            conn->start();
+            co_return conn;
+        }
+
+        // 连接数和每个连接的请求数都已达上限, 等待其他请求完成
+        if (!co_await SlotAwaiter(*this, deadline))
+        {
+            timed_out = true;
+            co_return nullptr;
+        }
+    }
+}
+
+// 当前线程到backend的连接池, 执行器线程和事件循环一一对应
+static FastCgiPool &poolFor(EventLoop &loop, const FastCgiBackend &backend)
+{
+    thread_local std::unordered_map<const FastCgiBackend *, std::unique_ptr<FastCgiPool>> pools;
+    std::unique_ptr<FastCgiPool> &pool = pools[&backend];
+    if (pool == nullptr)
+        pool.reset(new FastCgiPool(loop, backend));
+    return *pool;
+}
+
+Task<FastCgiResult> fastCgiRequest(EventLoop &loop, const FastCgiBackend &backend, const FastCgiParams &params,
+                                   std::string_view body)
+{
+    // 时限覆盖取得连接和等待响应
+    const auto deadline = backend.timeout_ms > 0
+                              ? std::chrono::steady_clock::now() + std::chrono::milliseconds(backend.timeout_ms)
+                              : std::chrono::steady_clock::time_point::max();
+
+    FastCgiResult result{0, std::string()};
+    FastCgiPool &pool = poolFor(loop, backend);
+    bool timed_out = false;
+    std::shared_ptr<FastCgiConnection> conn = co_await pool.acquire(deadline, timed_out);
+    if (conn == nullptr)
+    {
+        result.error_status = timed_out ? 504 : 502;
+        co_return result;
+    }
+
+    PendingRequest request;
+    uint16_t id = conn->submit(request, params, body);
+    EventLoop::TimerId timer = 0;
+    if (backend.timeout_ms > 0)
+    {
+        // 剩余不足1毫秒时按1毫秒计
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        timer = loop.runAfter(std::max<int64_t>(remaining.count(), 1), [conn, id] { conn->timeout(id); });
+    }
+
+    co_await ResponseAwaiter{request};
+
+    if (timer != 0)
+        loop.cancelTimer(timer);
+    pool.release(conn);
+
+    result.error_status = request.error_status;
+    result.output = std::move(request.output);
+    co_return result;
+}
\ No newline at end of file
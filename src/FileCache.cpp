@@ -0,0 +1,290 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 16:18:47
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 16:18:47
+ * @FilePath: /WebServerByCPP/src/FileCache.cpp
+ * @Description: 热点静态文件缓存实现, LRU链表加哈希表, 文件内容在锁外读取, 使用代数防止放入已失效的内容
+ */
+#include "../include/FileCache.h"
+#include "../include/HttpResponse.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 影响文件内容或路径映射的事件
+static const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+FileCache::FileCache(size_t capacity, size_t max_file_size)
+    : capacity(capacity), max_file_size(max_file_size), lru_list(), slots(), used_bytes(0), generation(0),
+      inotify_fd(-1), watch_dirs()
+{
+}
+
+FileCache::~FileCache()
+{
+    if (inotify_fd != -1)
+    {
+        close(inotify_fd);
+    }
+}
+
+bool FileCache::isCacheablePath(const std::string &path)
+{
+    return path.find("//") == std::string::npos && path.find("/./") == std::string::npos;
+}
+
+bool FileCache::isWatchedPath(const std::string &path) const
+{
+    if (real_root.empty() || path.compare(0, watch_root.size(), watch_root) != 0 || path[watch_root.size()] != '/')
+        return false;
+
+    // 解析后的路径必须正好是真实根目录加上相同的相对路径
+    char *resolved = realpath(path.c_str(), nullptr);
+    if (resolved == nullptr)
+        return false;
+    const std::string real(resolved);
+    free(resolved);
+    return real.compare(0, real_root.size(), real_root) == 0 &&
+           real.compare(real_root.size(), std::string::npos, path, watch_root.size(), std::string::npos) == 0;
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::get(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = slots.find(path);
+    if (it == slots.end())
+        return nullptr;
+
+    // 移到链表头部
+    lru_list.splice(lru_list.begin(), lru_list, it->second.lru_position);
+    return it->second.entry;
+}
+
+bool FileCache::contains(const std::string &path) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return slots.find(path) != slots.end();
+}
+
+std::shared_ptr<const FileCache::Entry> FileCache::load(const std::string &path)
+{
+    if (!isCacheablePath(path))
+        return nullptr;
+
+    uint64_t start_generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        start_generation = generation;
+    }
+
+    // 在锁外读取文件, 不阻塞其他线程的查找
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) ||
+        static_cast<size_t>(st.st_size) > max_file_size || !isWatchedPath(path))
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->content.resize(st.st_size);
+    size_t total = 0;
+    while (total < entry->content.size())
+    {
+        ssize_t n = read(fd, &entry->content[total], entry->content.size() - total);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    close(fd);
+
+    // 读取期间文件被截断, 放弃缓存
+    if (total != entry->content.size())
+        return nullptr;
+
+    HttpResponse response = HttpResponse::ok();
+    response.addHeader("Content-Length", std::to_string(total));
+    entry->head_keep_alive = response.buildHead(true);
+    entry->head_close = response.buildHead(false);
+
+    if (entry->size() > capacity)
+        return entry;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 读取期间发生过失效, 读到的内容可能已过期, 本次照常使用但不放入缓存
+    if (generation != start_generation)
+        return entry;
+
+    eraseLocked(path);
+    lru_list.push_front(path);
+    slots[path] = Slot{entry, lru_list.begin()};
+    used_bytes += entry->size();
+    evictLocked();
+    return entry;
+}
+
+void FileCache::eraseLocked(const std::string &path)
+{
+    auto it = slots.find(path);
+    if (it == slots.end())
+        return;
+
+    used_bytes -= it->second.entry->size();
+    lru_list.erase(it->second.lru_position);
+    slots.erase(it);
+}
+
+void FileCache::evictLocked()
+{
+    while (used_bytes > capacity && !lru_list.empty())
+    {
+        // 复制路径, eraseLocked会删除链表节点
+        std::string victim = lru_list.back();
+        eraseLocked(victim);
+    }
+}
+
+void FileCache::invalidate(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ++generation;
+    eraseLocked(path);
+}
+
+void FileCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ++generation;
+    slots.clear();
+    lru_list.clear();
+    used_bytes = 0;
+}
+
+bool FileCache::startWatching(const std::string &root)
+{
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd == -1)
+    {
+        std::cerr << "inotify_init1失败: " << strerror(errno) << '\n';
+        return false;
+    }
+
+    // 去掉末尾的斜杠, 与请求路径的拼接方式保持一致
+    std::string dir = root;
+    while (dir.size() > 1 && dir.back() == '/')
+        dir.pop_back();
+
+    watchDirectory(dir);
+    char *resolved = realpath(dir.c_str(), nullptr);
+    if (watch_dirs.empty() || resolved == nullptr)
+    {
+        free(resolved);
+        close(inotify_fd);
+        inotify_fd = -1;
+        watch_dirs.clear();
+        return false;
+    }
+    watch_root = dir;
+    real_root = resolved;
+    free(resolved);
+    return true;
+}
+
+void FileCache::watchDirectory(const std::string &dir)
+{
+    int wd = inotify_add_watch(inotify_fd, dir.c_str(), WATCH_MASK | IN_ONLYDIR);
+    if (wd == -1)
+    {
+        std::cerr << "无法监视目录 " << dir << ": " << strerror(errno) << '\n';
+        return;
+    }
+    watch_dirs[wd] = dir;
+
+    DIR *handle = opendir(dir.c_str());
+    if (handle == nullptr)
+        return;
+
+    struct dirent *item;
+    while ((item = readdir(handle)) != nullptr)
+    {
+        if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0)
+            continue;
+
+        std::string child = dir + '/' + item->d_name;
+        struct stat st;
+        if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            watchDirectory(child);
+        }
+    }
+    closedir(handle);
+}
+
+void FileCache::handleWatchEvents()
+{
+    alignas(struct inotify_event) char buf[4096];
+
+    // 边缘触发, 读到EAGAIN为止
+    while (true)
+    {
+        ssize_t n = read(inotify_fd, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        for (char *p = buf; p < buf + n;)
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            // 事件队列溢出, 不知道丢失了哪些事件
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                clear();
+                continue;
+            }
+
+            auto dir = watch_dirs.find(event->wd);
+            if (dir == watch_dirs.end())
+                continue;
+
+            if (event->mask & IN_IGNORED)
+            {
+                watch_dirs.erase(dir);
+                continue;
+            }
+
+            // 目录本身或其中的子目录发生变化, 影响范围难以确定, 清空全部缓存
+            if ((event->mask & IN_ISDIR) || (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)))
+            {
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && event->len > 0)
+                {
+                    watchDirectory(dir->second + '/' + event->name);
+                }
+                clear();
+                continue;
+            }
+
+            if (event->len > 0)
+            {
+                invalidate(dir->second + '/' + event->name);
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,800 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 09:58:02
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-16 09:58:02
+ * @FilePath: /WebServerByCPP/src/HttpConnection.cpp
+ * @Description: HTTP连接实现, 在边缘触发模式下读空/写满socket直到EAGAIN, 读取时使用Buffer批量读入
+ * 请求完整后按处理器类型投递到静态文件通道(工作线程池)或CGI通道(协程执行器)交给RequestHandler处理, 队列已满时直接返回503
+ * 状态页请求由当前线程直接生成响应, 不进入任何通道
+ * 处理器输出写入缓冲区, 处理完成后回到循环线程由写就绪事件驱动发送
+ * 持久连接上响应发送后取走已处理的请求数据, 继续解析缓冲区中剩余的数据或等待下一个请求
+ * 每个连接同一时刻只有一个期限定时器: 等待新请求(空闲)、读取请求头、读取请求体、发送响应停滞, 超时即关闭连接
+ * 支持请求流水线: 一次读入的多个请求依次处理, 工作线程在同一个任务中处理已到达的后续请求,
+ * 响应按请求顺序追加到输出缓冲区, 全部完成后用一次send发出
+ * 输出队列由内存段和文件段组成, 连续的内存数据(多个响应的头部和响应体)合并为一段, 由一次send发出
+ * 文件段使用sendfile零拷贝发送, 非阻塞socket上的部分发送从记录的偏移继续
+ * io_uring后端下不再自行读取, 事件循环交付的数据在处理期间暂存, 处理完成后再并入输入缓冲区
+ */
+#include "../include/HttpConnection.h"
+#include "../include/EventLoop.h"
+#include "../include/Executor.h"
+#include "../include/HttpRequest.h"
+#include "../include/HttpResponse.h"
+#include "../include/HttpServer.h"
+#include "../include/RequestHandler.h"
+#include "../include/ThreadPool.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+HttpConnection::HttpConnection(EventLoop *loop, int client_socket, HttpServer &server)
+    : loop(loop), client_socket(client_socket), server(server), closed(false), handling(false), peer_closed(false),
+      read_pending(false), keep_alive(false), close_after_write(false), output_blocked(false), input_overflow(false),
+      cgi_lane(false),
+      dispatch_pending(false), dispatch_time(), request_count(0),
+      deadline(Deadline::NONE), deadline_timer(0), deadline_request(0), write_progress(false), input_buffer(),
+      deferred_input(0), output_queue(), output_bytes(0),
+      request(server.getDocRoot(), server.getDefaultDocument(), server.getFileCache(), server.getStatusPath(),
+              server.getFastCgiRoutes())
+{
+}
+
+HttpConnection::~HttpConnection()
+{
+    clearOutput();
+    if (!closed)
+    {
+        close(client_socket);
+    }
+    server.connectionClosed();
+}
+
+void HttpConnection::start()
+{
+    auto self = shared_from_this();
+    try
+    {
+        loop->addFd(
+            client_socket, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            [self](uint32_t events) { self->handleEvent(events); },
+            [self](const char *data, ssize_t len) { self->handleData(data, len); });
+        updateDeadline();
+    }
+    catch (const std::exception &e)
+    {
+        // 注册失败时连接对象随self释放, 析构函数负责关闭socket
+        std::cerr << "注册连接失败: " << e.what() << '\n';
+    }
+}
+
+void HttpConnection::send(const char *data, size_t len)
+{
+    // 连续的内存数据合并到同一段中
+    if (output_queue.empty() || output_queue.back().file_fd != -1)
+    {
+        output_queue.push_back(OutputChunk{Buffer(), -1, 0, 0});
+    }
+    output_queue.back().data.append(data, len);
+    output_bytes += len;
+}
+
+void HttpConnection::send(const std::string &data)
+{
+    send(data.data(), data.size());
+}
+
+void HttpConnection::send(Buffer &&data)
+{
+    const size_t len = data.readableBytes();
+    if (len == 0)
+        return;
+    output_queue.push_back(OutputChunk{std::move(data), -1, 0, 0});
+    output_bytes += len;
+}
+
+void HttpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (length == 0)
+    {
+        close(fd);
+        return;
+    }
+    output_queue.push_back(OutputChunk{Buffer(0), fd, offset, length});
+    output_bytes += length;
+}
+
+void HttpConnection::truncateOutput(size_t mark)
+{
+    while (output_bytes > mark && !output_queue.empty())
+    {
+        OutputChunk &chunk = output_queue.back();
+        const size_t excess = output_bytes - mark;
+        const size_t size = chunk.file_fd != -1 ? chunk.length : chunk.data.readableBytes();
+        if (size <= excess)
+        {
+            if (chunk.file_fd != -1)
+                close(chunk.file_fd);
+            output_queue.pop_back();
+            output_bytes -= size;
+        }
+        else
+        {
+            if (chunk.file_fd != -1)
+                chunk.length -= excess;
+            else
+                chunk.data.truncate(size - excess);
+            output_bytes = mark;
+        }
+    }
+}
+
+void HttpConnection::clearOutput()
+{
+    truncateOutput(0);
+}
+
+void HttpConnection::handleEvent(uint32_t events)
+{
+    if ((events & EPOLLHUP) && !(events & EPOLLIN))
+    {
+        handleClose();
+        return;
+    }
+    if (events & EPOLLERR)
+    {
+        handleClose();
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP))
+    {
+        // 对端已关闭时必须读到0才能确认, 否则一次短读即可说明内核缓冲区已读空
+        handleRead((events & EPOLLRDHUP) != 0);
+    }
+    if (!closed && (events & EPOLLOUT))
+    {
+        handleWrite();
+    }
+}
+
+void HttpConnection::handleRead(bool drain)
+{
+    // 请求中的string_view指向输入缓冲区, 处理期间不能读取(可能导致缓冲区扩容)
+    if (handling)
+    {
+        read_pending = true;
+        return;
+    }
+
+    // 客户端不读取响应时也不再读取它发来的数据, 由TCP流量控制限制对端; 输出发送完毕后再读取
+    if (output_blocked)
+    {
+        read_pending = true;
+        return;
+    }
+
+    // 边缘触发: 读到EAGAIN, 或者一次没有填满缓冲区的短读
+    // 输入缓冲区中尚未解析的数据与本轮读取的合计不超过MAX_PENDING_INPUT, 超过时先解析已读到的请求,
+    // 对端持续发送而不读取响应时输入缓冲区不会无限增长; 剩余数据只是一个不完整的请求时(大小由请求解析限制)继续读取
+    size_t budget = input_buffer.readableBytes() < MAX_PENDING_INPUT
+                        ? MAX_PENDING_INPUT - input_buffer.readableBytes()
+                        : 0;
+    while (true)
+    {
+        bool more = false;
+        size_t round = 0;
+        while (true)
+        {
+            if (round >= budget)
+            {
+                more = true;
+                break;
+            }
+            const size_t capacity = input_buffer.readCapacity();
+            int saved_errno = 0;
+            ssize_t n = input_buffer.readFd(client_socket, &saved_errno);
+            if (n > 0)
+            {
+                round += static_cast<size_t>(n);
+                // 即将关闭的连接不再缓存后续数据
+                if (close_after_write)
+                {
+                    input_buffer.retrieveAll();
+                }
+                if (!drain && static_cast<size_t>(n) < capacity)
+                    break;
+            }
+            else if (n == 0)
+            {
+                peer_closed = true;
+                break;
+            }
+            else
+            {
+                if (saved_errno == EINTR)
+                    continue;
+                if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK)
+                    break;
+                handleClose();
+                return;
+            }
+        }
+
+        processRequest();
+
+        // 内核中还有数据: 正在处理或输出积压时推迟到之后读取, 否则继续下一轮
+        if (!more || closed)
+            return;
+        if (handling || output_blocked)
+        {
+            read_pending = true;
+            return;
+        }
+        budget = MAX_PENDING_INPUT;
+    }
+}
+
+void HttpConnection::handleData(const char *data, ssize_t len)
+{
+    if (closed)
+        return;
+
+    if (len > 0)
+    {
+        // 即将关闭的连接不再缓存后续数据; 处理期间输入缓冲区由工作线程使用, 先暂存
+        if (close_after_write)
+            return;
+        if (handling)
+        {
+            if (input_overflow || deferred_input.readableBytes() + len > MAX_PENDING_INPUT)
+            {
+                input_overflow = true;
+                deferred_input.retrieveAll();
+                return;
+            }
+            deferred_input.append(data, len);
+            return;
+        }
+        if (output_blocked && input_buffer.readableBytes() + len > MAX_PENDING_INPUT)
+        {
+            // 客户端只发送不接收, 丢弃输入, 发送完已有响应后关闭连接
+            close_after_write = true;
+            input_buffer.retrieveAll();
+            return;
+        }
+        input_buffer.append(data, len);
+    }
+    else if (len == 0)
+    {
+        peer_closed = true;
+        if (handling)
+            return;
+    }
+    else
+    {
+        // 处理期间输出队列由工作线程使用, 出错的连接在处理完成后由发送失败关闭
+        if (handling)
+        {
+            peer_closed = true;
+            return;
+        }
+        handleClose();
+        return;
+    }
+
+    processRequest();
+}
+
+void HttpConnection::handleWrite()
+{
+    // 工作线程正在写入输出缓冲区
+    if (handling || closed)
+        return;
+
+    while (!output_queue.empty())
+    {
+        OutputChunk &chunk = output_queue.front();
+        ssize_t n;
+        if (chunk.file_fd == -1)
+        {
+            // 后面紧跟文件体时使用MSG_MORE, 响应头与文件开头合并到同一个TCP段中发出
+            int flags = MSG_NOSIGNAL;
+            if (output_queue.size() > 1 && output_queue[1].file_fd != -1)
+                flags |= MSG_MORE;
+            n = ::send(client_socket, chunk.data.peek(), chunk.data.readableBytes(), flags);
+            if (n > 0)
+            {
+                chunk.data.retrieve(n);
+                output_bytes -= n;
+                write_progress = true;
+                if (chunk.data.readableBytes() == 0)
+                    output_queue.pop_front();
+                continue;
+            }
+        }
+        else
+        {
+            // 文件内容由内核直接从页缓存发送到socket, 不经过用户空间; offset由sendfile更新
+            n = ::sendfile(client_socket, chunk.file_fd, &chunk.offset, chunk.length);
+            if (n > 0)
+            {
+                chunk.length -= n;
+                output_bytes -= n;
+                write_progress = true;
+                if (chunk.length == 0)
+                {
+                    close(chunk.file_fd);
+                    output_queue.pop_front();
+                }
+                continue;
+            }
+            if (n == 0)
+            {
+                // 文件在发送期间被截断, 已声明的Content-Length无法满足, 只能关闭连接
+                std::cerr << "发送文件时文件被截断" << '\n';
+                handleClose();
+                return;
+            }
+        }
+
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            updateDeadline();
+            return; // 等待下一次写就绪事件
+        }
+        else
+        {
+            handleClose();
+            return;
+        }
+    }
+
+    if (close_after_write)
+    {
+        handleClose();
+        return;
+    }
+
+    // 积压的输出已发送完毕, 补上暂停期间推迟的读取, 继续解析后续请求
+    if (output_blocked)
+    {
+        output_blocked = false;
+        if (read_pending)
+        {
+            read_pending = false;
+            handleRead(true);
+            return;
+        }
+        processRequest();
+        return;
+    }
+
+    maybeClose();
+    updateDeadline();
+}
+
+void HttpConnection::handleClose()
+{
+    if (closed)
+        return;
+
+    closed = true;
+    setDeadline(Deadline::NONE);
+    clearOutput();
+    loop->removeFd(client_socket);
+    close(client_socket);
+}
+
+void HttpConnection::handleDeadline(Deadline expired)
+{
+    deadline_timer = 0;
+
+    // 请求处理期间不计时
+    if (closed || handling)
+        return;
+
+    static const char *const NAMES[] = {"", "空闲", "读取请求头", "读取请求体", "发送响应"};
+    if (expired != Deadline::IDLE)
+    {
+        std::cerr << "连接" << NAMES[static_cast<int>(expired)] << "超时, 关闭连接" << '\n';
+    }
+    handleClose();
+}
+
+void HttpConnection::updateDeadline()
+{
+    if (closed)
+        return;
+
+    // 当前所处的阶段决定适用哪种期限
+    Deadline next;
+    if (handling)
+        next = Deadline::NONE;
+    else if (output_bytes > 0)
+        next = Deadline::WRITE;
+    else if (input_buffer.readableBytes() == 0)
+        next = Deadline::IDLE;
+    else if (!request.headersComplete())
+        next = Deadline::HEADER;
+    else
+        next = Deadline::BODY;
+
+    // 读取请求头/请求体的期限从进入该阶段开始计算, 不因收到零星数据而延长(防止慢速攻击);
+    // 每个新请求重新计时; 发送响应的期限在每次发送出数据后重新计时
+    bool progress = next == Deadline::WRITE && write_progress;
+    write_progress = false;
+    if (next == deadline && deadline_request == request_count && !progress)
+        return;
+
+    setDeadline(next);
+}
+
+void HttpConnection::setDeadline(Deadline next)
+{
+    if (deadline_timer != 0)
+    {
+        loop->cancelTimer(deadline_timer);
+        deadline_timer = 0;
+    }
+    deadline = next;
+    deadline_request = request_count;
+
+    int timeout;
+    switch (next)
+    {
+    case Deadline::IDLE:
+        timeout = server.getKeepAliveTimeout();
+        break;
+    case Deadline::HEADER:
+        timeout = server.getHeaderTimeout();
+        break;
+    case Deadline::BODY:
+        timeout = server.getBodyTimeout();
+        break;
+    case Deadline::WRITE:
+        timeout = server.getWriteTimeout();
+        break;
+    default:
+        return;
+    }
+
+    // 定时器只持有弱引用, 不延长连接的生命周期
+    std::weak_ptr<HttpConnection> weak_self = shared_from_this();
+    deadline_timer = loop->runAfter(timeout, [weak_self, next] {
+        if (auto self = weak_self.lock())
+        {
+            self->handleDeadline(next);
+        }
+    });
+}
+
+void HttpConnection::maybeClose()
+{
+    if (!closed && peer_closed && !handling && output_bytes == 0)
+    {
+        handleClose();
+    }
+}
+
+// 判断逗号分隔的头部值中是否包含指定的token(不区分大小写)
+static bool hasToken(std::string_view value, std::string_view token)
+{
+    while (!value.empty())
+    {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        size_t start = item.find_first_not_of(" \t");
+        size_t end = item.find_last_not_of(" \t");
+        if (start != std::string_view::npos)
+        {
+            item = item.substr(start, end + 1 - start);
+            if (item.size() == token.size() && strncasecmp(item.data(), token.data(), token.size()) == 0)
+                return true;
+        }
+        if (comma == std::string_view::npos)
+            break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+bool HttpConnection::shouldKeepAlive() const
+{
+    if (request_count >= server.getMaxKeepAliveRequests())
+        return false;
+
+    // HTTP/1.1默认保持连接, HTTP/1.0需要显式声明keep-alive
+    std::string_view connection = request.getHeader("connection");
+    if (request.getVersion() == "HTTP/1.1")
+        return !hasToken(connection, "close");
+    return hasToken(connection, "keep-alive");
+}
+
+void HttpConnection::respondError(int status_code, bool keep)
+{
+    keep_alive = keep;
+    HttpResponse::sendError(*this, status_code);
+    finishRequest();
+}
+
+void HttpConnection::respondStatus(bool keep)
+{
+    keep_alive = keep;
+    HttpResponse response = HttpResponse::ok();
+    response.addHeader("Content-Type", "text/plain; charset=utf-8");
+    response.addHeader("Cache-Control", "no-store");
+    response.setBody(server.buildStatus());
+    response.send(*this);
+    finishRequest();
+}
+
+void HttpConnection::finishRequest()
+{
+    // 取走已处理的请求数据, 之后的字节属于下一个请求
+    input_buffer.retrieve(request.messageLength());
+    request.reset();
+
+    if (!keep_alive)
+    {
+        close_after_write = true;
+        input_buffer.retrieveAll();
+    }
+}
+
+HttpConnection::RequestStep HttpConnection::takeRequest()
+{
+    // 每次都传入从请求起始位置开始的全部数据, 解析器从上次停下的位置继续
+    HttpRequest::ParseResult result = request.parse(input_buffer.peek(), input_buffer.readableBytes());
+    if (result == HttpRequest::ParseResult::NEED_MORE)
+        return RequestStep::NEED_MORE;
+
+    if (result == HttpRequest::ParseResult::ERROR)
+    {
+        // 请求格式错误返回400, 请求边界已无法确定, 只能关闭连接
+        std::cerr << "解析请求错误: " << request.getErrorMessage() << '\n';
+        respondError(400, false);
+        return RequestStep::RESPONDED;
+    }
+
+    ++request_count;
+    bool keep = shouldKeepAlive();
+
+    // 状态页不经过通道, 通道饱和时仍然可以查看
+    if (request.isStatus())
+    {
+        respondStatus(keep);
+        return RequestStep::RESPONDED;
+    }
+
+    if (!request.getErrorMessage().empty())
+    {
+        // 检查error_message判断是文件不存在还是其他错误
+        if (request.getErrorMessage().find("File not found") != std::string::npos)
+        {
+            // debug信息
+            std::cerr << "========== HttpConnection::processRequest error Info ==========" << '\n';
+            std::cerr << "URL: " << request.getUrl() << '\n';
+            std::cerr << "path: " << request.getPath() << '\n';
+            std::cerr << "error message: " << request.getErrorMessage() << '\n';
+            std::cerr << "========== HttpConnection::processRequest error Info End ==========" << '\n';
+
+            // 文件不存在返回404
+            respondError(404, keep);
+        }
+        else
+        {
+            respondError(400, keep);
+        }
+        return RequestStep::RESPONDED;
+    }
+
+    keep_alive = keep;
+    return RequestStep::DISPATCH;
+}
+
+bool HttpConnection::canTakeRequest() const
+{
+    return !close_after_write && input_buffer.readableBytes() > 0 && output_bytes < OUTPUT_HIGH_WATER;
+}
+
+void HttpConnection::processRequest()
+{
+    while (!closed && !handling && !close_after_write)
+    {
+        // 客户端不读取响应时暂停处理后续请求, 待输出发送完毕后继续
+        if (output_bytes >= OUTPUT_HIGH_WATER)
+        {
+            output_blocked = true;
+            break;
+        }
+
+        RequestStep step;
+        if (dispatch_pending)
+        {
+            // 工作线程已解析出的属于另一个通道的请求; 之后的读取可能使输入缓冲区扩容, 重新定位请求中的视图
+            dispatch_pending = false;
+            request.parse(input_buffer.peek(), input_buffer.readableBytes());
+            step = RequestStep::DISPATCH;
+        }
+        else
+        {
+            step = input_buffer.readableBytes() > 0 ? takeRequest() : RequestStep::NEED_MORE;
+        }
+        if (step == RequestStep::NEED_MORE)
+            break; // 等待下一个请求或更多数据
+
+        if (step == RequestStep::RESPONDED)
+            continue; // 继续解析流水线中的下一个请求
+
+        // 按处理器类型投递到对应的通道, 处理期间连接(包括输入/输出缓冲区)由工作线程独占
+        auto self = shared_from_this();
+        handling = true;
+        cgi_lane = request.isCgi();
+        dispatch_time = std::chrono::steady_clock::now();
+        bool posted;
+        if (cgi_lane)
+        {
+            posted = server.getCgiExecutor().trySpawn(
+                [self](EventLoop &executor_loop) { return self->runAsyncHandler(executor_loop); });
+        }
+        else
+        {
+            posted = server.getStaticPool().tryPost([self] { self->runHandler(); });
+        }
+        if (!posted)
+        {
+            // 任务队列已满, 直接拒绝, 不再占用更多线程和内存
+            handling = false;
+            respondError(503, false);
+        }
+    }
+
+    // 本轮产生的所有响应按顺序在输出缓冲区中, 一起发送
+    handleWrite();
+    maybeClose();
+    updateDeadline();
+}
+
+void HttpConnection::runHandler()
+{
+    // 流水线中已经到达的后续请求在同一个任务中依次处理, 响应按请求顺序追加到输出缓冲区
+    RequestStep step = admitDispatched() ? RequestStep::DISPATCH : RequestStep::NEED_MORE;
+    while (step != RequestStep::NEED_MORE)
+    {
+        if (step == RequestStep::DISPATCH)
+        {
+            const size_t output_mark = output_bytes;
+            try
+            {
+                // 根据请求类型创建处理器
+                auto handler = RequestHandler::createHandler(request);
+
+                // 处理请求
+                handler->handle(request, *this);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "处理请求错误: " << e.what() << '\n';
+
+                // 丢弃本请求已写出的部分响应(之前请求的响应保留), 发送500错误后关闭连接
+                truncateOutput(output_mark);
+                keep_alive = false;
+                HttpResponse::sendError(*this, 500);
+            }
+            finishRequest();
+        }
+
+        step = takeNextInLane();
+    }
+
+    // 回到所属循环线程发送响应
+    auto self = shared_from_this();
+    loop->queueInLoop([self] { self->onRequestHandled(); });
+}
+
+Task<void> HttpConnection::runAsyncHandler(EventLoop &executor_loop)
+{
+    // 挂起期间保持连接存活
+    auto self = shared_from_this();
+
+    RequestStep step = admitDispatched() ? RequestStep::DISPATCH : RequestStep::NEED_MORE;
+    while (step != RequestStep::NEED_MORE)
+    {
+        if (step == RequestStep::DISPATCH)
+        {
+            const size_t output_mark = output_bytes;
+            try
+            {
+                auto handler = RequestHandler::createHandler(request);
+                co_await handler->handleAsync(request, *this, executor_loop);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "处理请求错误: " << e.what() << '\n';
+
+                // 与runHandler相同: 丢弃本请求的部分响应, 发送500错误后关闭连接
+                truncateOutput(output_mark);
+                keep_alive = false;
+                HttpResponse::sendError(*this, 500);
+            }
+            finishRequest();
+        }
+
+        step = takeNextInLane();
+    }
+
+    loop->queueInLoop([self] { self->onRequestHandled(); });
+}
+
+bool HttpConnection::admitDispatched()
+{
+    if (server.admitQueued(cgi_lane, dispatch_time))
+        return true;
+
+    // 排队过久或通道积压: 直接返回503; 连接本身没有问题, 按请求的意愿保持, 客户端重试时不必重新建立连接
+    respondError(503, keep_alive);
+    return false;
+}
+
+HttpConnection::RequestStep HttpConnection::takeNextInLane()
+{
+    if (!canTakeRequest())
+        return RequestStep::NEED_MORE;
+
+    // 属于另一个通道的请求交回循环线程投递, 不占用当前通道
+    RequestStep step = takeRequest();
+    if (step == RequestStep::DISPATCH && request.isCgi() != cgi_lane)
+    {
+        dispatch_pending = true;
+        return RequestStep::NEED_MORE;
+    }
+    return step;
+}
+
+void HttpConnection::onRequestHandled()
+{
+    handling = false;
+
+    // 处理期间连接可能已因错误被关闭
+    if (closed)
+        return;
+
+    // 处理期间暂存的输入超过上限, 请求流已不完整: 发送完已有响应后关闭连接
+    if (input_overflow)
+    {
+        close_after_write = true;
+        deferred_input.retrieveAll();
+        input_buffer.retrieveAll();
+        handleWrite();
+        return;
+    }
+
+    // 处理期间交付的数据
+    if (deferred_input.readableBytes() > 0)
+    {
+        if (!close_after_write)
+            input_buffer.append(deferred_input.peek(), deferred_input.readableBytes());
+        deferred_input.retrieveAll();
+    }
+
+    // 补上处理期间被推迟的读取, 读取后会继续解析下一个请求; 输出积压时等发送完毕后再读取
+    if (read_pending && output_bytes < OUTPUT_HIGH_WATER)
+    {
+        read_pending = false;
+        handleRead(true);
+    }
+    else
+    {
+        processRequest();
+    }
+}
\ No newline at end of file
@@ -2,308 +2,402 @@
  * @Author: No_World 2259881867@qq.com
  * @Date: 2025-05-15 19:26:23
  * @LastEditors: No_World 2259881867@qq.com
- * @LastEditTime: 2025-05-24 20:25:14
+ * @LastEditTime: 2026-10-16 15:02:37
  * @FilePath: /WebServerByCPP/src/HttpRequest.cpp
- * @Description: HTTP请求解析实现, 负责从客户端socket读取数据并解析HTTP请求
+ * @Description: HTTP请求解析实现, 以可恢复状态机的方式增量解析连接缓冲区中的HTTP请求
  * 支持GET和POST请求处理, 包含请求解析、查询字符串提取、文件路径解析和HTTP头解析
+ * 所有字段以偏移量记录, 不拷贝缓冲区中的数据, 只有文件路径需要拼接到复用的字符串中
  */
 #include "../include/HttpRequest.h"
+#include "../include/FastCgi.h"
+#include "../include/FileCache.h"
 #include <algorithm>
 #include <cerrno>
+#include <charconv>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
-#include <sstream>
 #include <sys/stat.h>
 
-// 添加网络编程头文件
 #include <strings.h>
-#include <sys/socket.h>
-#include <unistd.h>
 const char PATH_SEP = '/';
 
 // 构造函数初始化
-HttpRequest::HttpRequest(const std::string &root, const std::string &default_doc)
-    : method(), url(), path(), query_string(), headers(), is_cgi(false), error_message(), DOC_ROOT(root),
-      DEFAULT_DOCUMENT(default_doc)
+HttpRequest::HttpRequest(std::string_view root, std::string_view default_doc, FileCache *cache,
+                         std::string_view status_path, const FastCgiRoutes *routes)
+    : base(nullptr), state(ParseState::REQUEST_LINE), scan_offset(0), header_length(0), content_length(0), method(),
+      url(), query_string(), version(), headers(), header_count(0), path(), is_cgi(false), is_status(false),
+      fastcgi_backend(nullptr), script_offset(0), error_message(), DOC_ROOT(root), DEFAULT_DOCUMENT(default_doc),
+      STATUS_PATH(status_path), file_cache(cache), fastcgi_routes(routes)
 {
     // 从配置参数初始化
 }
 
-// 静态方法：从socket读取一行数据
-size_t HttpRequest::getLine(int sock, std::string &buf)
+// 清空解析状态, 保留path的容量以便复用
+void HttpRequest::reset()
 {
-    buf.clear();
-    char c = '\0';
-    int n;
-
-    while ((buf.length() < MAX_LINE_LENGTH - 1) && (c != '\n'))
-    {
-        n = recv(sock, &c, 1, 0);
-
-        if (n > 0)
-        {
-            if (c == '\r')
-            {
-                n = recv(sock, &c, 1, MSG_PEEK);
-                if ((n > 0) && (c == '\n'))
-                    recv(sock, &c, 1, 0);
-                else
-                    c = '\n';
-            }
-            if (c != '\n')
-                buf.push_back(c);
-        }
-        else
-        {
-            c = '\n';
-        }
-    }
-
-    return buf.length();
+    base = nullptr;
+    state = ParseState::REQUEST_LINE;
+    scan_offset = 0;
+    header_length = 0;
+    content_length = 0;
+    method = std::string_view();
+    url = Token();
+    query_string = Token();
+    version = Token();
+    header_count = 0;
+    path.clear();
+    is_cgi = false;
+    is_status = false;
+    fastcgi_backend = nullptr;
+    script_offset = 0;
+    error_message.clear();
 }
 
-// 判断文件是否存在且检查其类型
-bool HttpRequest::checkFileAccess()
+HttpRequest::ParseResult HttpRequest::fail(const char *message)
 {
-    struct stat st;
-
-#ifdef DEBUG
-    std::cout << "========== HttpRequest::checkFileAccess Debug Info ==========" << '\n';
-    std::cout << "Checking path: " << path << '\n';
-    std::cout << "Path length: " << path.length() << '\n';
-    std::cout << "========== HttpRequest::checkFileAccess Debug Info End ==========" << '\n';
-#endif
+    error_message = message;
+    state = ParseState::ERROR;
+    return ParseResult::ERROR;
+}
 
-    if (stat(path.c_str(), &st) == -1)
-    {
-        // 文件不存在或权限不足
-        std::cerr << "stat() failed for path: " << path << '\n';
-        std::cerr << "errno: " << errno << " (" << strerror(errno) << ")" << '\n';
-        error_message = "File not found: " + path;
-        return false;
-    }
+// 解析HTTP请求
+HttpRequest::ParseResult HttpRequest::parse(const char *data, size_t len)
+{
+    base = data;
 
-    // 处理目录
-    if ((st.st_mode & S_IFMT) == S_IFDIR)
+    while (true)
     {
-        if (path.back() != PATH_SEP)
+        switch (state)
         {
-            path += PATH_SEP;
-        }
-        path += DEFAULT_DOCUMENT;
-
-        // 再次检查文件是否存在
-        if (stat(path.c_str(), &st) == -1)
-        {
-            error_message = "Default document not found: " + path;
-            return false;
-        }
-    }
-
-    // 检查文件是否可执行
-    if ((st.st_mode & S_IXUSR) || (st.st_mode & S_IXGRP) || (st.st_mode & S_IXOTH))
-    {
-        is_cgi = true;
-    }
+        case ParseState::REQUEST_LINE:
+        case ParseState::HEADERS: {
+            // 用memchr在用户态查找行边界, 兼容"\r\n"和"\n"
+            const char *line = data + scan_offset;
+            const char *eol = static_cast<const char *>(memchr(line, '\n', len - scan_offset));
+            if (eol == nullptr)
+            {
+                if (len > MAX_HEADER_SIZE)
+                    return fail("Request header too large");
+                return ParseResult::NEED_MORE;
+            }
 
-    return true;
-}
+            size_t line_len = eol - line;
+            if (line_len > 0 && line[line_len - 1] == '\r')
+                --line_len;
+            scan_offset = eol + 1 - data;
+            if (scan_offset > MAX_HEADER_SIZE)
+                return fail("Request header too large");
 
-// URL解码函数
-std::string HttpRequest::urlDecode(const std::string &encoded)
-{
-    std::string result;
-    for (size_t i = 0; i < encoded.length(); ++i)
-    {
-        if (encoded[i] == '%' && i + 2 < encoded.length())
-        {
-            int value;
-            std::istringstream is(encoded.substr(i + 1, 2));
-            if (is >> std::hex >> value)
+            if (state == ParseState::REQUEST_LINE)
             {
-                result += static_cast<char>(value);
-                i += 2;
+                // 忽略请求行之前的空行(例如上一个请求体之后多余的CRLF)
+                if (line_len == 0)
+                    continue;
+                if (!parseRequestLine(line, line_len))
+                    return ParseResult::ERROR;
+                state = ParseState::HEADERS;
             }
-            else
+            else if (line_len == 0)
             {
-                result += encoded[i];
+                // 空行, 请求头结束
+                header_length = scan_offset;
+                if (!finishHeaders())
+                    return ParseResult::ERROR;
+                state = ParseState::BODY;
             }
+            else if (!parseHeaderLine(line, line_len))
+            {
+                return ParseResult::ERROR;
+            }
+            break;
         }
-        else if (encoded[i] == '+')
-        {
-            result += ' ';
-        }
-        else
-        {
-            result += encoded[i];
+        case ParseState::BODY:
+            // POST请求需要等待请求体完整
+            if (len < header_length + content_length)
+                return ParseResult::NEED_MORE;
+            state = ParseState::COMPLETE;
+            return ParseResult::COMPLETE;
+        case ParseState::COMPLETE:
+            return ParseResult::COMPLETE;
+        case ParseState::ERROR:
+            return ParseResult::ERROR;
         }
     }
-    return result;
 }
 
-// 解析HTTP请求
-bool HttpRequest::parse(int client_socket)
+// 解析请求行: 方法 URL [版本]
+bool HttpRequest::parseRequestLine(const char *line, size_t len)
 {
-    std::string buf;
-    int numchars;
-
-    // 防止恶意请求设置超时
-    // (实际实现应考虑设置socket超时选项)
+    std::string_view buf(line, len);
+    const size_t offset = line - base;
 
-    // 读取第一行，包含请求方法和URL
-    numchars = getLine(client_socket, buf);
-    if (numchars <= 0)
+    // 解析请求方法
+    size_t start = 0;
+    size_t end = buf.find_first_of(" \t");
+    if (end == std::string_view::npos)
     {
-        error_message = "Empty request";
+        fail("Invalid request format");
         return false;
     }
 
-    // 解析请求方法
-    size_t start = 0;
-    size_t end = buf.find_first_of(" \t");
-    if (end != std::string::npos)
+    // 不区分大小写比较, 统一记录为大写
+    if (end == 3 && strncasecmp(line, "GET", 3) == 0)
+    {
+        method = "GET";
+    }
+    else if (end == 4 && strncasecmp(line, "POST", 4) == 0)
     {
-        method = buf.substr(start, end - start);
-        // 统一转换为大写以便不区分大小写比较
-        std::transform(method.begin(), method.end(), method.begin(), ::toupper);
+        // POST请求一定触发CGI
+        method = "POST";
+        is_cgi = true;
     }
     else
     {
-        error_message = "Invalid request format";
+        // 检查请求方法是否支持
+        fail("Method not supported");
+        error_message.append(": ").append(line, end);
         return false;
     }
 
-    // 检查请求方法是否支持
-    if (method != "GET" && method != "POST")
+    // 解析URL
+    start = buf.find_first_not_of(" \t", end);
+    if (start == std::string_view::npos)
     {
-        error_message = "Method not supported: " + method;
+        fail("URL not found in request");
         return false;
     }
+    end = buf.find_first_of(" \t", start);
+    if (end == std::string_view::npos)
+        end = len;
 
-    // POST请求一定触发CGI
-    if (method == "POST")
+    // 分离查询字符串, 在解码之前分离以免把编码后的'?'当作分隔符
+    std::string_view target = buf.substr(start, end - start);
+    size_t query_pos = target.find('?');
+    if (query_pos != std::string_view::npos)
     {
-        is_cgi = true;
+        url = Token{static_cast<uint32_t>(offset + start), static_cast<uint32_t>(query_pos)};
+        query_string = Token{static_cast<uint32_t>(offset + start + query_pos + 1),
+                             static_cast<uint32_t>(target.size() - query_pos - 1)};
+        // 处理GET请求的查询字符串
+        if (method == "GET")
+            is_cgi = true;
+    }
+    else
+    {
+        url = Token{static_cast<uint32_t>(offset + start), static_cast<uint32_t>(target.size())};
     }
 
-    // 解析URL
+    // 解析协议版本(可省略)
     start = buf.find_first_not_of(" \t", end);
-    if (start == std::string::npos)
+    if (start != std::string_view::npos)
     {
-        error_message = "URL not found in request";
-        return false;
+        end = buf.find_last_not_of(" \t");
+        version = Token{static_cast<uint32_t>(offset + start), static_cast<uint32_t>(end + 1 - start)};
     }
 
-    end = buf.find_first_of(" \t", start);
-    url = urlDecode(buf.substr(start, (end != std::string::npos) ? end - start : std::string::npos));
+    return true;
+}
 
-    // 防止目录遍历攻击
-    if (url.find("..") != std::string::npos)
+// 解析头部行: 名称: 值
+bool HttpRequest::parseHeaderLine(const char *line, size_t len)
+{
+    std::string_view buf(line, len);
+    const size_t offset = line - base;
+
+    size_t colon_pos = buf.find(':');
+    if (colon_pos == std::string_view::npos)
+        return true; // 忽略格式不正确的头部行
+
+    if (header_count >= MAX_HEADERS)
     {
-        error_message = "Invalid URL path (directory traversal attempt)";
+        fail("Too many headers");
         return false;
     }
 
-    // 如果URL是根路径，使用默认文档
-    if (url == "/" || url.empty())
+    // 去除值前后的空白
+    size_t value_start = buf.find_first_not_of(" \t", colon_pos + 1);
+    size_t value_end = buf.find_last_not_of(" \t");
+    size_t value_len = (value_start == std::string_view::npos) ? 0 : value_end + 1 - value_start;
+    if (value_start == std::string_view::npos)
+        value_start = len;
+
+    HeaderToken &header = headers[header_count++];
+    header.name = Token{static_cast<uint32_t>(offset), static_cast<uint32_t>(colon_pos)};
+    header.value = Token{static_cast<uint32_t>(offset + value_start), static_cast<uint32_t>(value_len)};
+    return true;
+}
+
+// 请求头完整后: 确定请求体长度并构造文件路径
+bool HttpRequest::finishHeaders()
+{
+    // 不支持分块传输的请求体, 无法确定请求边界时直接拒绝
+    if (!getHeader("transfer-encoding").empty())
     {
-        // 不要修改url，保持为"/"
-        // 不要这样做：url = DEFAULT_DOCUMENT;
+        fail("Transfer-Encoding not supported");
+        return false;
     }
 
-    // 处理GET请求的查询字符串
-    if (method == "GET")
+    std::string_view length_header = getHeader("content-length");
+    if (!length_header.empty())
     {
-        size_t query_pos = url.find('?');
-        if (query_pos != std::string::npos)
+        size_t value = 0;
+        auto result = std::from_chars(length_header.data(), length_header.data() + length_header.size(), value);
+        if (result.ec != std::errc() || result.ptr != length_header.data() + length_header.size())
         {
-            query_string = url.substr(query_pos + 1);
-            url = url.substr(0, query_pos);
-            is_cgi = true;
+            fail("Invalid Content-Length");
+            return false;
+        }
+        if (value > MAX_BODY_SIZE)
+        {
+            fail("Request body too large");
+            return false;
         }
+        content_length = value;
+    }
+
+    // 状态页由连接直接生成, 不查找文件
+    if (method == "GET" && !STATUS_PATH.empty() && view(url) == STATUS_PATH)
+    {
+        is_status = true;
+        return true;
     }
 
     // 构造文件路径
     // 确保DOC_ROOT末尾有斜杠，url开头没有斜杠
-    std::string doc_root_path = DOC_ROOT;
-    if (!doc_root_path.empty() && doc_root_path.back() != PATH_SEP)
-        doc_root_path += PATH_SEP;
-    if (!url.empty() && url[0] == PATH_SEP)
-        url = url.substr(1);
-    path = doc_root_path + url; // debug
+    std::string_view raw_url = view(url);
+    if (!raw_url.empty() && raw_url[0] == PATH_SEP)
+        raw_url.remove_prefix(1);
+
+    path.assign(DOC_ROOT.data(), DOC_ROOT.size());
+    if (!path.empty() && path.back() != PATH_SEP)
+        path += PATH_SEP;
+    const size_t url_start = path.size();
+    urlDecode(raw_url, path);
+
+    // 防止目录遍历攻击
+    if (path.find("..", url_start) != std::string::npos)
+    {
+        fail("Invalid URL path (directory traversal attempt)");
+        return false;
+    }
 
 #ifdef DEBUG
     std::cout << "========== HttpRequest::parse Debug Info ==========" << '\n';
     std::cout << "DOC_ROOT: " << DOC_ROOT << '\n';
-    std::cout << "doc_root_path: " << doc_root_path << '\n';
-    std::cout << "url: " << url << '\n';
+    std::cout << "url: " << view(url) << '\n';
     std::cout << "path: " << path << '\n';
     std::cout << "========== HttpRequest::parse Debug Info End ==========" << '\n';
 #endif
     // 规范化路径格式并处理默认文件
-    std::replace(path.begin(), path.end(), '\\', PATH_SEP);
+    std::replace(path.begin() + url_start, path.end(), '\\', PATH_SEP);
 
     // 如果路径以'/'结尾或是根路径，添加默认文档
-    if (path.back() == PATH_SEP || url == "/" || url.empty())
+    if (path.back() == PATH_SEP || raw_url.empty())
     {
         if (path.back() != PATH_SEP)
             path += PATH_SEP;
-        path += DEFAULT_DOCUMENT;
+        path.append(DEFAULT_DOCUMENT.data(), DEFAULT_DOCUMENT.size());
     }
 
-    // 检查文件访问权限
-    if (!checkFileAccess())
+    // 路由到FastCGI后端的请求由后端处理, 脚本不必存在于本地文件系统
+    script_offset = url_start > 0 ? url_start - 1 : 0;
+    if (fastcgi_routes != nullptr)
     {
-        // 清空剩余的请求头
-        while ((numchars > 0) && buf != "\n")
+        fastcgi_backend = fastcgi_routes->match(getScriptName());
+        if (fastcgi_backend != nullptr)
         {
-            numchars = getLine(client_socket, buf);
+            is_cgi = true;
+            return true;
         }
+    }
+
+    // 检查文件访问权限, 文件不存在不影响请求边界, 由调用者根据错误信息返回404
+    checkFileAccess();
+    return true;
+}
+
+// 判断文件是否存在且检查其类型
+bool HttpRequest::checkFileAccess()
+{
+    struct stat st;
+
+#ifdef DEBUG
+    std::cout << "========== HttpRequest::checkFileAccess Debug Info ==========" << '\n';
+    std::cout << "Checking path: " << path << '\n';
+    std::cout << "Path length: " << path.length() << '\n';
+    std::cout << "========== HttpRequest::checkFileAccess Debug Info End ==========" << '\n';
+#endif
+
+    // 已缓存的文件一定是存在且不可执行的普通文件, 不必再stat
+    if (!is_cgi && file_cache != nullptr && file_cache->contains(path))
+        return true;
+
+    if (stat(path.c_str(), &st) == -1)
+    {
+        // 文件不存在或权限不足
+        std::cerr << "stat() failed for path: " << path << '\n';
+        std::cerr << "errno: " << errno << " (" << strerror(errno) << ")" << '\n';
+        error_message = "File not found: " + path;
         return false;
     }
 
-    // 读取并存储HTTP头信息
-    numchars = getLine(client_socket, buf);
-    while ((numchars > 0) && !buf.empty())
+    // 处理目录
+    if ((st.st_mode & S_IFMT) == S_IFDIR)
     {
-        // 移除末尾的\r (如果存在)
-        if (!buf.empty() && buf.back() == '\r')
+        if (path.back() != PATH_SEP)
         {
-            buf.pop_back();
+            path += PATH_SEP;
         }
+        path += DEFAULT_DOCUMENT;
 
-        // 解析头部信息
-        size_t colon_pos = buf.find(':');
-        if (colon_pos != std::string::npos)
+        // 再次检查文件是否存在
+        if (stat(path.c_str(), &st) == -1)
         {
-            std::string header_name = buf.substr(0, colon_pos);
-            std::string header_value = buf.substr(colon_pos + 1);
+            error_message = "Default document not found: " + path;
+            return false;
+        }
+    }
 
-            // 规范化头部名称 (不区分大小写)
-            std::transform(header_name.begin(), header_name.end(), header_name.begin(), ::tolower);
+    // 检查文件是否可执行
+    if ((st.st_mode & S_IXUSR) || (st.st_mode & S_IXGRP) || (st.st_mode & S_IXOTH))
+    {
+        is_cgi = true;
+    }
 
-            // 去除值前面的空格
-            size_t value_start = header_value.find_first_not_of(" \t");
-            if (value_start != std::string::npos)
-            {
-                header_value = header_value.substr(value_start);
-            }
+    return true;
+}
 
-            // 存储头部信息
-            headers[header_name] = header_value;
+// URL解码函数
+void HttpRequest::urlDecode(std::string_view encoded, std::string &out)
+{
+    auto hexValue = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
 
-            // 检查Content-Length (对POST请求)
-            if (method == "POST" && header_name == "content-length")
-            {
-                // 实际处理应在这里解析并验证内容长度
-            }
+    for (size_t i = 0; i < encoded.length(); ++i)
+    {
+        if (encoded[i] == '%' && i + 2 < encoded.length() && hexValue(encoded[i + 1]) >= 0 &&
+            hexValue(encoded[i + 2]) >= 0)
+        {
+            out += static_cast<char>(hexValue(encoded[i + 1]) * 16 + hexValue(encoded[i + 2]));
+            i += 2;
+        }
+        else if (encoded[i] == '+')
+        {
+            out += ' ';
+        }
+        else
+        {
+            out += encoded[i];
         }
-
-        numchars = getLine(client_socket, buf);
     }
-
-    return true; // 解析成功
 }
 
 // 获取错误信息方法
@@ -312,30 +406,32 @@ const std::string &HttpRequest::getErrorMessage() const
     return error_message;
 }
 
-std::string HttpRequest::getHeader(const std::string &name) const
+std::string_view HttpRequest::getHeader(std::string_view name) const
 {
-    auto it = headers.find(name);
-    if (it != headers.end())
+    for (size_t i = 0; i < header_count; ++i)
     {
-        return it->second;
+        std::string_view header_name = view(headers[i].name);
+        if (header_name.size() == name.size() && strncasecmp(header_name.data(), name.data(), name.size()) == 0)
+        {
+            return view(headers[i].value);
+        }
     }
-    return ""; // 未找到则返回空字符串
+    return std::string_view(); // 未找到则返回空
 }
 
 // 友元函数：重载输出运算符
 std::ostream &operator<<(std::ostream &os, const HttpRequest &req)
 {
     os << "Method: " << req.method << "\n"
-       << "URL: " << req.url << "\n"
+       << "URL: " << req.getUrl() << "\n"
        << "Path: " << req.path << "\n"
-       << "Query String: " << req.query_string << "\n"
+       << "Query String: " << req.getQueryString() << "\n"
        << "CGI Request: " << (req.is_cgi ? "Yes" : "No") << "\n"
        << "Headers:\n";
 
-    // 使用C++11 range-based for循环
-    for (const auto &header : req.headers)
+    for (size_t i = 0; i < req.header_count; ++i)
     {
-        os << "  " << header.first << ": " << header.second << "\n";
+        os << "  " << req.view(req.headers[i].name) << ": " << req.view(req.headers[i].value) << "\n";
     }
 
     if (!req.error_message.empty())
@@ -6,17 +6,48 @@
  * @FilePath: /WebServerByCPP/src/HttpResponse.cpp
  * @Description: HTTP响应类实现，负责构建和发送HTTP响应，包括状态码、头部和响应体
  * 提供了标准HTTP响应的工厂方法，支持200 OK、404 Not Found、400 Bad Request等常见状态
- * 实现了文件传输功能，能够高效地将文件内容发送给客户端
+ * 实现了文件传输功能，文件内容交给连接以sendfile零拷贝发送给客户端
+ * 持久连接要求每个响应都能确定消息边界, 因此发送前总会补全Content-Length
+ * 响应行和所有头部先序列化到一块连续内存中, 再与响应体一起交给连接, 由一次系统调用发出
+ * 错误响应的完整报文(保持连接/关闭连接各一份)只生成一次, Date头位于固定偏移处, 发送时填入每秒更新一次的缓存值
+ * 503响应带Retry-After头; 过载时拒绝新连接也直接把预先生成的报文写入socket, 拒绝的开销只有一次writev
  * 作为服务器响应处理的核心组件，确保了HTTP协议的正确实现
  */
 #include "../include/HttpResponse.h"
+#include "../include/HttpConnection.h"
+#include <algorithm>
 #include <cstring>
+#include <ctime>
 #include <iostream>
-#include <sys/socket.h>
-#include <unistd.h>
+#include <string>
+#include <sys/uio.h>
+#include <utility>
 
 #define SERVER_STRING "Server: NoWorld's http/0.1.0\r\n"
 
+// Date头的值为固定长度29字节, 例如"Thu, 01 Jan 1970 00:00:00 GMT"
+static const size_t DATE_LENGTH = 29;
+
+// 503响应中Retry-After头的值(秒), 在生成错误响应报文之前设置
+static int retry_after_seconds = 1;
+
+// 当前时间的HTTP日期格式, 每个线程每秒只格式化一次
+static const char *httpDate()
+{
+    thread_local char date[DATE_LENGTH + 1] = {0};
+    thread_local time_t cached_time = 0;
+
+    time_t now = time(nullptr);
+    if (now != cached_time)
+    {
+        struct tm tm_value;
+        gmtime_r(&now, &tm_value);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm_value);
+        cached_time = now;
+    }
+    return date;
+}
+
 HttpResponse::HttpResponse() : status_code(200), status_message("OK")
 {
     addStandardHeaders();
@@ -46,51 +77,159 @@ void HttpResponse::addStandardHeaders()
     headers["Content-Type"] = "text/html";
 }
 
-void HttpResponse::send(int client_socket)
+std::string HttpResponse::buildHead(bool keep_alive)
 {
-    // 发送响应行
-    std::string status_line = "HTTP/1.0 " + std::to_string(status_code) + " " + status_message + "\r\n";
-    ::send(client_socket, status_line.c_str(), status_line.length(), 0);
+    headers["Connection"] = keep_alive ? "keep-alive" : "close";
+
+    // 先计算长度, 一次分配
+    size_t size = 32 + status_message.size();
+    for (const auto &header : headers)
+    {
+        size += header.first.size() + header.second.size() + 4;
+    }
+
+    std::string head;
+    head.reserve(size);
+
+    // 响应行
+    head += "HTTP/1.1 ";
+    head += std::to_string(status_code);
+    head += ' ';
+    head += status_message;
+    head += "\r\n";
 
-    // 发送头部
+    // 头部
     for (const auto &header : headers)
     {
-        std::string header_line = header.first + ": " + header.second + "\r\n";
-        ::send(client_socket, header_line.c_str(), header_line.length(), 0);
+        head += header.first;
+        head += ": ";
+        head += header.second;
+        head += "\r\n";
     }
 
-    // 发送空行，表示头部结束
-    ::send(client_socket, "\r\n", 2, 0);
+    // 空行，表示头部结束
+    head += "\r\n";
+    return head;
+}
+
+void HttpResponse::sendHead(HttpConnection &conn)
+{
+    // 连接是否保持由连接根据请求决定
+    // 响应头作为一个整体写入输出队列, 与紧随其后的响应体位于同一段连续内存中
+    conn.send(buildHead(conn.isKeepAlive()));
+}
+
+void HttpResponse::send(HttpConnection &conn)
+{
+    // 客户端依靠Content-Length确定响应结束位置
+    if (!hasHeader("Content-Length"))
+    {
+        headers["Content-Length"] = std::to_string(body.length());
+    }
+    sendHead(conn);
 
     // 发送响应体
     if (!body.empty())
     {
-        ::send(client_socket, body.c_str(), body.length(), 0);
+        conn.send(body);
     }
 }
 
-void HttpResponse::sendFile(int client_socket, FILE *resource)
+void HttpResponse::sendFile(HttpConnection &conn, int fd, off_t size)
 {
     // 先发送头部
-    std::string status_line = "HTTP/1.0 " + std::to_string(status_code) + " " + status_message + "\r\n";
-    ::send(client_socket, status_line.c_str(), status_line.length(), 0);
+    headers["Content-Length"] = std::to_string(size);
+    sendHead(conn);
 
-    for (const auto &header : headers)
-    {
-        std::string header_line = header.first + ": " + header.second + "\r\n";
-        ::send(client_socket, header_line.c_str(), header_line.length(), 0);
-    }
+    // 文件内容不读入用户空间, 由连接在发送时使用sendfile
+    conn.sendFile(fd, 0, static_cast<size_t>(size));
+}
 
-    // 发送空行
-    ::send(client_socket, "\r\n", 2, 0);
+const std::vector<HttpResponse::ErrorResponse> &HttpResponse::errorResponses()
+{
+    // 局部静态变量的初始化是线程安全的
+    static const std::vector<ErrorResponse> responses = buildErrorResponses();
+    return responses;
+}
+
+std::vector<HttpResponse::ErrorResponse> HttpResponse::buildErrorResponses()
+{
+    std::vector<ErrorResponse> responses;
+    const std::pair<int, HttpResponse (*)()> factories[] = {
+        {400, &HttpResponse::badRequest},  {404, &HttpResponse::notFound},
+        {500, &HttpResponse::serverError}, {501, &HttpResponse::notImplemented},
+        {502, &HttpResponse::badGateway},  {503, &HttpResponse::serviceUnavailable},
+        {504, &HttpResponse::gatewayTimeout},
+    };
 
-    // 读取文件内容到字符串
-    char temp_buf[1024];
-    size_t bytes_read;
-    while ((bytes_read = fread(temp_buf, 1, sizeof(temp_buf), resource)) > 0)
+    const std::string placeholder(DATE_LENGTH, ' ');
+    for (const auto &factory : factories)
     {
-        ::send(client_socket, temp_buf, bytes_read, 0);
+        HttpResponse response = factory.second();
+        response.addHeader("Date", placeholder);
+
+        ErrorResponse canned;
+        canned.status_code = factory.first;
+        for (int keep = 0; keep < 2; ++keep)
+        {
+            canned.wire[keep] = response.buildHead(keep != 0) + response.body;
+            canned.date_offset[keep] = canned.wire[keep].find("Date: ") + 6;
+        }
+        responses.push_back(std::move(canned));
     }
+    return responses;
+}
+
+void HttpResponse::initErrorResponses(int retry_after)
+{
+    retry_after_seconds = retry_after > 0 ? retry_after : 1;
+    errorResponses();
+}
+
+const HttpResponse::ErrorResponse &HttpResponse::findErrorResponse(int status_code)
+{
+    const std::vector<ErrorResponse> &responses = errorResponses();
+    auto findStatus = [&responses](int code) {
+        return std::find_if(responses.begin(), responses.end(),
+                            [code](const ErrorResponse &item) { return item.status_code == code; });
+    };
+
+    // 未知状态码按500处理
+    auto canned = findStatus(status_code);
+    if (canned == responses.end())
+        canned = findStatus(500);
+    return *canned;
+}
+
+void HttpResponse::sendError(HttpConnection &conn, int status_code)
+{
+    const ErrorResponse &canned = findErrorResponse(status_code);
+
+    // 报文按Date值切成三段追加到同一段输出缓冲区中, 仍然由一次系统调用发出
+    const int keep = conn.isKeepAlive() ? 1 : 0;
+    const std::string &wire = canned.wire[keep];
+    const size_t offset = canned.date_offset[keep];
+    conn.send(wire.data(), offset);
+    conn.send(httpDate(), DATE_LENGTH);
+    conn.send(wire.data() + offset + DATE_LENGTH, wire.size() - offset - DATE_LENGTH);
+}
+
+void HttpResponse::writeError(int fd, int status_code)
+{
+    const ErrorResponse &canned = findErrorResponse(status_code);
+    const std::string &wire = canned.wire[0];
+    const size_t offset = canned.date_offset[0];
+
+    // 新连接的发送缓冲区是空的, 报文一定能一次写入; 写入失败也只是客户端收不到响应
+    struct iovec parts[3];
+    parts[0].iov_base = const_cast<char *>(wire.data());
+    parts[0].iov_len = offset;
+    parts[1].iov_base = const_cast<char *>(httpDate());
+    parts[1].iov_len = DATE_LENGTH;
+    parts[2].iov_base = const_cast<char *>(wire.data() + offset + DATE_LENGTH);
+    parts[2].iov_len = wire.size() - offset - DATE_LENGTH;
+    ssize_t n = writev(fd, parts, 3);
+    (void)n;
 }
 
 // 静态方法：创建常用响应
@@ -149,4 +288,41 @@ HttpResponse HttpResponse::notImplemented()
                        "</BODY></HTML>\r\n";
     response.setBody(body);
     return response;
+}
+
+HttpResponse HttpResponse::badGateway()
+{
+    HttpResponse response;
+    response.setStatus(502, "BAD GATEWAY");
+
+    std::string body = "<HTML><TITLE>502 Bad Gateway</TITLE>\r\n"
+                       "<BODY><P>The application server is unavailable or returned an invalid response.\r\n"
+                       "</BODY></HTML>\r\n";
+    response.setBody(body);
+    return response;
+}
+
+HttpResponse HttpResponse::gatewayTimeout()
+{
+    HttpResponse response;
+    response.setStatus(504, "GATEWAY TIMEOUT");
+
+    std::string body = "<HTML><TITLE>504 Gateway Timeout</TITLE>\r\n"
+                       "<BODY><P>The application server did not respond in time.\r\n"
+                       "</BODY></HTML>\r\n";
+    response.setBody(body);
+    return response;
+}
+
+HttpResponse HttpResponse::serviceUnavailable()
+{
+    HttpResponse response;
+    response.setStatus(503, "SERVICE UNAVAILABLE");
+    response.addHeader("Retry-After", std::to_string(retry_after_seconds));
+
+    std::string body = "<HTML><TITLE>503 Service Unavailable</TITLE>\r\n"
+                       "<BODY><P>The server is busy, please try again later.\r\n"
+                       "</BODY></HTML>\r\n";
+    response.setBody(body);
+    return response;
 }
\ No newline at end of file
@@ -4,79 +4,321 @@
  * @LastEditors: No_World 2259881867@qq.com
  * @LastEditTime: 2025-05-24 20:46:55
  * @FilePath: /WebServerByCPP/src/HttpServer.cpp
- * @Description: HTTP服务器核心实现，提供服务器的初始化、启动、停止和请求处理功能
- * 实现了多线程客户端请求处理，提高并发性能，支持短连接和异常处理机制
+ * @Description: HTTP服务器核心实现，提供服务器的初始化、启动、停止和连接分发功能
+ * 主线程事件循环以边缘触发方式accept新连接, 并轮询分配给固定数量的IO线程, 每个连接由HttpConnection驱动
+ * 启用reuse_port时每个IO线程拥有一个SO_REUSEPORT监听socket并自行accept, 由内核在线程间分配新连接
+ * 配置io_backend=io_uring时所有事件循环使用io_uring后端, 新连接由多次accept交付, 内核不支持时退回epoll
  * 集成ConfigManager读取配置参数，灵活调整服务器行为
  * 通过组合HttpRequest、HttpResponse和RequestHandler等组件，实现完整的HTTP请求响应流程
  */
 #include "../include/HttpServer.h"
+#include "../include/CoDel.h"
 #include "../include/ConfigManager.h"
-#include "../include/HttpRequest.h"
+#include "../include/EventLoop.h"
+#include "../include/Executor.h"
+#include "../include/FastCgi.h"
+#include "../include/FileCache.h"
+#include "../include/HttpConnection.h"
 #include "../include/HttpResponse.h"
 #include "../include/RequestHandler.h"
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <sys/epoll.h>
 
 // 构造函数
 HttpServer::HttpServer(unsigned short port)
-    : port(ConfigManager::getInt("port", port)), server_socket(-1), running(false)
+    : port(ConfigManager::getInt("port", port)), running(false), next_loop(0), io_thread_count(1), reuse_port(false),
+      listen_backlog(SOMAXCONN), inherited_socket(false), use_io_uring(false),
+      pool_adjust_interval(1000), keep_alive_timeout(5000), header_timeout(10000), body_timeout(60000),
+      write_timeout(30000), max_keep_alive_requests(100),
+      max_connections(0), connection_count(0), queue_deadline(0), rejected_connections(0), deadline_drops(0),
+      codel_drops(0)
 {
     doc_root = ConfigManager::getString("document_root", "httpdocs");
     default_document = ConfigManager::getString("default_document", "test.html");
+
+    // IO线程数量, 默认与CPU核数相同
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    io_thread_count = ConfigManager::getInt("io_threads", cores > 0 ? cores : 1);
+    if (io_thread_count < 1)
+    {
+        io_thread_count = 1;
+    }
+
+    // 监听队列长度; 启用reuse_port时每个IO线程有自己的监听socket和accept循环
+    listen_backlog = ConfigManager::getInt("listen_backlog", SOMAXCONN);
+    if (listen_backlog < 1)
+    {
+        listen_backlog = SOMAXCONN;
+    }
+    reuse_port = ConfigManager::getBool("reuse_port", false);
+
+    // IO后端, 不认识的值按epoll处理
+    std::string io_backend = ConfigManager::getString("io_backend", "epoll");
+    use_io_uring = io_backend == "io_uring";
+    if (!use_io_uring && io_backend != "epoll")
+    {
+        std::cerr << "未知的io_backend: " << io_backend << ", 使用epoll" << '\n';
+    }
+
+    // 持久连接参数, 配置文件中超时时间以秒为单位
+    auto readTimeout = [](const std::string &key, int default_seconds) {
+        int seconds = ConfigManager::getInt(key, default_seconds);
+        return (seconds > 0 ? seconds : 1) * 1000;
+    };
+    keep_alive_timeout = readTimeout("keep_alive_timeout", 5);
+
+    // 连接各阶段的时限, 防止慢速客户端长期占用连接
+    header_timeout = readTimeout("header_timeout", 10);
+    body_timeout = readTimeout("body_timeout", 60);
+    write_timeout = readTimeout("write_timeout", 30);
+    max_keep_alive_requests = ConfigManager::getInt("keep_alive_max_requests", 100);
+    if (max_keep_alive_requests < 1)
+    {
+        max_keep_alive_requests = 1;
+    }
+
+    // 预先生成错误响应报文
+    HttpResponse::initErrorResponses(ConfigManager::getInt("retry_after", 1));
+
+    // 静态文件缓存, 配置为0时不启用
+    int cache_size = ConfigManager::getInt("file_cache_size", 16 * 1024 * 1024);
+    int cache_max_file = ConfigManager::getInt("file_cache_max_file_size", 256 * 1024);
+    if (cache_size > 0 && cache_max_file > 0)
+    {
+        file_cache.reset(new FileCache(cache_size, cache_max_file));
+    }
+
+    // 静态文件通道的初始线程数、伸缩范围和任务队列长度
+    int worker_threads = ConfigManager::getInt("worker_threads", 8);
+    int worker_queue_size = ConfigManager::getInt("worker_queue_size", 1024);
+    if (worker_threads < 1)
+        worker_threads = 1;
+    ThreadPool::ResizePolicy policy;
+    policy.min_threads = std::max(ConfigManager::getInt("worker_min_threads", worker_threads), 1);
+    policy.max_threads = std::max(ConfigManager::getInt("worker_max_threads", worker_threads), 1);
+    policy.grow_wait_us = static_cast<int64_t>(ConfigManager::getInt("worker_grow_queue_wait", 2)) * 1000;
+    policy.shrink_utilization = ConfigManager::getInt("worker_shrink_utilization", 30) / 100.0;
+    policy.grow_samples = POOL_GROW_SAMPLES;
+    policy.shrink_samples = POOL_SHRINK_SAMPLES;
+    pool_adjust_interval = ConfigManager::getInt("worker_adjust_interval", 1000);
+    static_pool.reset(new ThreadPool(worker_threads, worker_queue_size > 0 ? worker_queue_size : 1, policy));
+
+    // CGI通道: 执行器线程数、同时执行的CGI请求数和等待队列长度
+    int executor_threads = ConfigManager::getInt("executor_threads", 2);
+    int cgi_concurrency = ConfigManager::getInt("cgi_concurrency", 64);
+    int cgi_queue_size = ConfigManager::getInt("cgi_queue_size", 256);
+    cgi_executor.reset(new Executor(executor_threads > 0 ? executor_threads : 1,
+                                    cgi_concurrency > 0 ? cgi_concurrency : 1, cgi_queue_size > 0 ? cgi_queue_size : 0,
+                                    use_io_uring ? EventLoop::Backend::IO_URING : EventLoop::Backend::EPOLL));
+
+    // CGI脚本的运行时限(秒)和输出大小上限(字节), 超出时终止脚本; 0表示不限制
+    CgiHandler::setLimits(std::max(ConfigManager::getInt("cgi_timeout", 30), 0),
+                          static_cast<size_t>(std::max(ConfigManager::getInt("cgi_max_output", 64 * 1024 * 1024), 0)));
+
+    status_path = ConfigManager::getString("status_path", "");
+
+    // FastCGI路由及每个执行器线程到每个后端的连接池参数, 超时时间以秒为单位
+    std::string routes = ConfigManager::getString("fastcgi_routes", "");
+    if (!routes.empty())
+    {
+        FastCgiBackend defaults;
+        defaults.unix_socket = false;
+        defaults.port = 0;
+        defaults.max_connections = static_cast<size_t>(std::max(ConfigManager::getInt("fastcgi_max_connections", 8), 1));
+        defaults.max_requests_per_conn = static_cast<size_t>(
+            std::clamp(ConfigManager::getInt("fastcgi_requests_per_connection", 1), 1, 65535)); // 请求ID为16位
+        defaults.timeout_ms = std::max(ConfigManager::getInt("fastcgi_timeout", 30), 0) * 1000;
+        defaults.max_output =
+            static_cast<size_t>(std::max(ConfigManager::getInt("fastcgi_max_output", 64 * 1024 * 1024), 0));
+        fastcgi_routes = FastCgiRoutes::parse(routes, defaults);
+        if (fastcgi_routes->empty())
+            fastcgi_routes.reset();
+        else
+            std::cout << "FastCGI路由: " << fastcgi_routes->describe() << '\n';
+    }
+
+    // 准入控制: 连接数上限、排队期限和各通道CoDel的目标排队时间, 配置为0时不启用
+    max_connections = std::max(ConfigManager::getInt("max_connections", 0), 0);
+    queue_deadline = std::chrono::milliseconds(std::max(ConfigManager::getInt("queue_deadline", 0), 0));
+    int codel_interval = ConfigManager::getInt("codel_interval", 100);
+    int static_target = ConfigManager::getInt("codel_target", 5);
+    int cgi_target = ConfigManager::getInt("cgi_codel_target", 100);
+    if (codel_interval > 0 && static_target > 0)
+    {
+        static_codel.reset(new CoDel(std::chrono::milliseconds(static_target), std::chrono::milliseconds(codel_interval)));
+    }
+    if (codel_interval > 0 && cgi_target > 0)
+    {
+        cgi_codel.reset(new CoDel(std::chrono::milliseconds(cgi_target), std::chrono::milliseconds(codel_interval)));
+    }
+}
+
+// 在状态页中追加一个通道的统计, 线程池和执行器提供相同的统计接口
+template <typename Lane>
+static void appendLaneStatus(std::string &out, const char *name, const Lane &pool)
+{
+    out += "lane ";
+    out += name;
+    out += ": threads=" + std::to_string(pool.threadCount());
+    out += " active=" + std::to_string(pool.activeCount());
+    out += " queued=" + std::to_string(pool.queueSize());
+    out += " completed=" + std::to_string(pool.completedCount());
+    out += " rejected=" + std::to_string(pool.rejectedCount());
+    out += "\n";
+}
+
+// 生成状态页内容, 只读取原子计数, 可在任意线程调用
+std::string HttpServer::buildStatus() const
+{
+    std::string out;
+    out.reserve(256);
+    appendLaneStatus(out, "static", *static_pool);
+    out += "lane static pool: min=" + std::to_string(static_pool->minThreads());
+    out += " max=" + std::to_string(static_pool->maxThreads());
+    out += " queue_wait_us=" + std::to_string(static_pool->sampledWaitMicros());
+    out += " utilization=" + std::to_string(static_pool->sampledUtilization()) + "%";
+    out += " grown=" + std::to_string(static_pool->growCount());
+    out += " shrunk=" + std::to_string(static_pool->shrinkCount());
+    out += "\n";
+    appendLaneStatus(out, "cgi", *cgi_executor);
+    out += "admission: connections=" + std::to_string(connection_count.load(std::memory_order_relaxed));
+    out += " max_connections=" + std::to_string(max_connections);
+    out += " rejected_connections=" + std::to_string(rejected_connections.load(std::memory_order_relaxed));
+    out += " deadline_drops=" + std::to_string(deadline_drops.load(std::memory_order_relaxed));
+    out += " codel_drops=" + std::to_string(codel_drops.load(std::memory_order_relaxed));
+    out += "\n";
+    return out;
+}
+
+bool HttpServer::admitQueued(bool cgi_lane, std::chrono::steady_clock::time_point dispatched_at)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto sojourn = now - dispatched_at;
+
+    // 超过期限的请求客户端多半已经放弃, 处理它只会让后面的请求等得更久
+    if (queue_deadline.count() > 0 && sojourn > queue_deadline)
+    {
+        deadline_drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    CoDel *codel = cgi_lane ? cgi_codel.get() : static_codel.get();
+    if (codel != nullptr && codel->shouldDrop(sojourn, now))
+    {
+        codel_drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// 定期采样静态文件线程池的负载并调整线程数, 在主循环线程中执行
+void HttpServer::schedulePoolAdjust()
+{
+    main_loop->runAfter(pool_adjust_interval, [this] {
+        static_pool->adjust();
+        schedulePoolAdjust();
+    });
 }
 
 // 析构函数
 HttpServer::~HttpServer()
 {
     stop();
-    if (server_socket != -1)
-    {
-        close(server_socket);
-        server_socket = -1;
-    }
+    closeSockets();
 }
 
-// 初始化socket
-void HttpServer::initSocket()
+// 创建一个绑定到指定端口的监听socket
+int HttpServer::createListenSocket(unsigned short port, int listen_backlog, bool reuse_port)
 {
     struct sockaddr_in server_addr;
 
-    // 创建socket
-    server_socket = socket(AF_INET, SOCK_STREAM, 0);
+    // 创建socket, 非阻塞模式配合边缘触发的accept循环
+    int listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 
-    if (server_socket == -1)
+    if (listen_socket == -1)
     {
         throw std::runtime_error("无法创建socket");
     }
     // 设置socket选项
     int opt = 1;
-    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+    if (setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
     {
-        close(server_socket);
+        close(listen_socket);
         throw std::runtime_error("设置socket选项失败");
     }
 
+    // 多个socket绑定同一端口, 由内核按连接的四元组哈希分配新连接
+    if (reuse_port && setsockopt(listen_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        close(listen_socket);
+        throw std::runtime_error("设置SO_REUSEPORT失败");
+    }
+
     // 绑定地址
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
-    if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    if (bind(listen_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
     {
-        close(server_socket);
+        close(listen_socket);
         throw std::runtime_error("绑定socket失败");
     }
 
-    // 监听
-    if (listen(server_socket, 5) < 0)
+    // 监听, 实际长度还受内核参数net.core.somaxconn限制
+    if (listen(listen_socket, listen_backlog) < 0)
     {
-        close(server_socket);
+        close(listen_socket);
         throw std::runtime_error("监听socket失败");
     }
 
-    std::cout << "HTTP服务器启动在端口 " << port << '\n';
+    return listen_socket;
+}
+
+// 使用继承自主进程的监听socket, 必须在start()之前调用
+void HttpServer::setListenSocket(int listen_socket)
+{
+    closeSockets();
+    listen_sockets.push_back(listen_socket);
+    inherited_socket = true;
+    reuse_port = false;
+}
+
+// 初始化socket
+void HttpServer::initSocket()
+{
+    // 监听socket由主进程创建, 与其他工作进程共享
+    if (inherited_socket)
+    {
+        std::cout << "HTTP服务器(进程" << getpid() << ")使用共享监听socket, 端口 " << port << '\n';
+        return;
+    }
+
+    // 启用SO_REUSEPORT时每个IO线程一个监听socket, 否则只有一个由主线程accept
+    int count = reuse_port ? io_thread_count : 1;
+    for (int i = 0; i < count; ++i)
+    {
+        listen_sockets.push_back(createListenSocket(port, listen_backlog, reuse_port));
+    }
+
+    std::cout << "HTTP服务器启动在端口 " << port << " (监听socket数: " << count << ", backlog: " << listen_backlog
+              << ")" << '\n';
+}
+
+// 关闭所有监听socket
+void HttpServer::closeSockets()
+{
+    for (int listen_socket : listen_sockets)
+    {
+        close(listen_socket);
+    }
+    listen_sockets.clear();
 }
 
 // 启动服务器
@@ -88,44 +330,97 @@ void HttpServer::start()
     try
     {
         initSocket();
-        running = true;
-
-        struct sockaddr_in client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
 
-        std::cout << "服务器等待连接..." << '\n';
+        // 创建事件循环
+        EventLoop::Backend backend = use_io_uring ? EventLoop::Backend::IO_URING : EventLoop::Backend::EPOLL;
+        main_loop.reset(new EventLoop(backend));
+        for (int i = 0; i < io_thread_count; ++i)
+        {
+            io_loops.emplace_back(new EventLoop(backend));
+        }
 
-        while (running)
+        // 在开始接受连接之前开始监视: 此前加载的缓存项不受监视, 失败时释放缓存也不会有连接仍在使用它
+        // 无法感知文件变化时缓存可能返回过期内容, 不启用
+        if (file_cache)
         {
-            // 接受连接
-            int client_sock = accept(server_socket, (struct sockaddr *)&client_addr, &client_addr_len);
+            if (file_cache->startWatching(doc_root))
+            {
+                main_loop->addFd(file_cache->getWatchFd(), EPOLLIN | EPOLLET,
+                                 [this](uint32_t) { file_cache->handleWatchEvents(); });
+            }
+            else
+            {
+                std::cerr << "无法监视文档根目录, 不启用文件缓存" << '\n';
+                file_cache.reset();
+            }
+        }
 
-            if (client_sock == -1)
+        if (reuse_port)
+        {
+            // 每个IO循环accept自己的监听socket, 新连接留在本线程处理; 在IO线程启动前注册
+            for (size_t i = 0; i < io_loops.size(); ++i)
             {
-                if (!running)
-                {
-                    break;
-                }
-                std::cerr << "接受客户端连接失败" << '\n';
-                continue;
+                addListener(io_loops[i].get(), listen_sockets[i], EPOLLIN | EPOLLET, io_loops[i].get());
             }
+        }
+        else
+        {
+            // 多个进程共享监听socket时使用EPOLLEXCLUSIVE, 新连接只唤醒其中一个进程
+            uint32_t events = EPOLLIN | EPOLLET;
+            if (inherited_socket)
+                events |= EPOLLEXCLUSIVE;
+            addListener(main_loop.get(), listen_sockets[0], events, nullptr);
+        }
 
-            std::cout << "新连接: IP=" << inet_ntoa(client_addr.sin_addr) << ", 端口=" << ntohs(client_addr.sin_port)
-                      << '\n';
+        for (auto &loop : io_loops)
+        {
+            EventLoop *io_loop = loop.get();
+            threads.emplace_back([io_loop] { io_loop->loop(); });
+        }
+        cgi_executor->start();
 
-            // 创建新线程处理请求
-            std::thread client_thread(&HttpServer::handleClient, this, client_sock);
-            client_thread.detach();
+        if (static_pool->minThreads() != static_pool->maxThreads() && pool_adjust_interval > 0)
+        {
+            schedulePoolAdjust();
         }
+        running = true;
+
+        std::cout << "服务器等待连接... (IO线程数: " << io_thread_count
+                  << ", 静态文件工作线程数: " << static_pool->threadCount()
+                  << ", CGI执行器线程数: " << cgi_executor->threadCount()
+                  << ", IO后端: "
+                  << (main_loop->getBackend() == EventLoop::Backend::IO_URING ? "io_uring" : "epoll") << ")" << '\n';
+
+        // 阻塞直到stop()被调用
+        main_loop->loop();
     }
     catch (const std::exception &e)
     {
         std::cerr << "服务器错误: " << e.what() << '\n';
         stop();
     }
+
+    // 退出所有IO线程并释放连接
+    for (auto &loop : io_loops)
+    {
+        loop->quit();
+    }
+    for (auto &thread : threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    threads.clear();
+
+    // 工作线程完成后会向IO循环投递任务, 必须在释放IO循环之前停止
+    static_pool->stop();
+    cgi_executor->stop();
+    io_loops.clear();
+    main_loop.reset();
+    closeSockets();
 }
 
-// 停止服务器
+// 停止服务器, 可在信号处理函数中调用
 void HttpServer::stop()
 {
     if (!running)
@@ -133,73 +428,87 @@ void HttpServer::stop()
 
     running = false;
 
-    if (server_socket != -1)
+    // 只唤醒主循环, 资源在start()返回前统一释放
+    if (main_loop)
     {
-        close(server_socket);
-        server_socket = -1;
+        main_loop->quit();
     }
 
     std::cout << "服务器已停止" << '\n';
 }
 
-// 处理客户端请求
-void HttpServer::handleClient(int client_sock)
+// 在loop上监听新连接, owner为空时轮询分配给IO线程
+void HttpServer::addListener(EventLoop *loop, int listen_socket, uint32_t events, EventLoop *owner)
 {
-    struct timeval timeout;
-    timeout.tv_sec = 5;
-    timeout.tv_usec = 0;
-    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    try
+    // epoll后端在就绪时循环accept4; io_uring后端由内核完成accept, 只需取得对端地址用于日志
+    loop->addListener(
+        listen_socket, events, [this, listen_socket, owner](uint32_t) { handleAccept(listen_socket, owner); },
+        [this, owner](int client_sock) {
+            struct sockaddr_in client_addr;
+            socklen_t client_addr_len = sizeof(client_addr);
+            memset(&client_addr, 0, sizeof(client_addr));
+            getpeername(client_sock, (struct sockaddr *)&client_addr, &client_addr_len);
+            acceptConnection(client_sock, client_addr, owner);
+        });
+}
+
+// 接受新连接
+void HttpServer::handleAccept(int listen_socket, EventLoop *owner)
+{
+    // 边缘触发: 必须一直accept到EAGAIN
+    while (true)
     {
-        HttpRequest request(doc_root, default_document);
+        struct sockaddr_in client_addr;
+        socklen_t client_addr_len = sizeof(client_addr);
+        int client_sock = accept4(listen_socket, (struct sockaddr *)&client_addr, &client_addr_len,
+                                  SOCK_NONBLOCK | SOCK_CLOEXEC);
 
-        // 解析请求
-        if (!request.parse(client_sock))
+        if (client_sock == -1)
         {
-            // 检查error_message判断是文件不存在还是真正的请求格式错误
-            if (request.getErrorMessage().find("File not found") != std::string::npos)
-            {
-                // debug信息
-                std::cerr << "========== HttpServer::handleClient error Info ==========" << '\n';
-                std::cerr << "URL: " << request.getUrl() << '\n';
-                std::cerr << "path: " << request.getPath() << '\n';
-                std::cerr << "error message: " << request.getErrorMessage() << '\n';
-                std::cerr << "========== HttpServer::handleClient error Info End ==========" << '\n';
-
-                // 文件不存在返回404
-                HttpResponse response = HttpResponse::notFound();
-                response.send(client_sock);
-            }
-            else
-            {
-                // 请求错误返回400
-                HttpResponse response = HttpResponse::badRequest();
-                response.send(client_sock);
-            }
-            return;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            std::cerr << "接受客户端连接失败: " << strerror(errno) << '\n';
+            break;
         }
 
-        // 根据请求类型创建处理器
-        auto handler = RequestHandler::createHandler(request);
+        acceptConnection(client_sock, client_addr, owner);
+    }
+}
 
-        // 处理请求
-        handler->handle(request, client_sock);
+// 接管一个新连接
+void HttpServer::acceptConnection(int client_sock, const struct sockaddr_in &client_addr, EventLoop *owner)
+{
+    // 连接数达到上限: 写入预先生成的503后立即关闭, 不创建连接对象
+    // 多个accept线程可能同时到达这里, 先占用名额再检查, 检查和计数是同一个原子操作, 不会超出上限
+    const int previous = connection_count.fetch_add(1, std::memory_order_relaxed);
+    if (max_connections > 0 && previous >= max_connections)
+    {
+        connection_count.fetch_sub(1, std::memory_order_relaxed);
+        HttpResponse::writeError(client_sock, 503);
+        // 关闭时接收缓冲区中还有未读的请求会发送RST, 客户端可能因此丢掉503; 先读走已到达的数据
+        char discard[4096];
+        ssize_t n = recv(client_sock, discard, sizeof(discard), MSG_DONTWAIT);
+        (void)n;
+        close(client_sock);
+        rejected_connections.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
-    catch (const std::exception &e)
+
+    // 多个线程可能同时accept, 不使用返回静态缓冲区的inet_ntoa
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client_addr.sin_addr, ip, sizeof(ip));
+    std::cout << "新连接: IP=" << ip << ", 端口=" << ntohs(client_addr.sin_port) << '\n';
+
+    // 由主线程accept时轮询分配给IO线程, 连接在所属循环线程中注册
+    EventLoop *loop = owner;
+    if (loop == nullptr)
     {
-        std::cerr << "处理请求错误: " << e.what() << '\n';
-        try
-        {
-            // 尝试发送500错误
-            HttpResponse response = HttpResponse::serverError();
-            response.send(client_sock);
-        }
-        catch (...)
-        {
-            // 忽略发送错误响应时的异常
-            std::cerr << "发送错误响应失败" << '\n';
-        }
+        loop = io_loops[next_loop].get();
+        next_loop = (next_loop + 1) % io_loops.size();
     }
-    // 关闭连接
-    close(client_sock);
+
+    auto conn = std::make_shared<HttpConnection>(loop, client_sock, *this);
+    loop->runInLoop([conn] { conn->start(); });
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 11:20:51
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 11:20:51
+ * @FilePath: /WebServerByCPP/src/IoUring.cpp
+ * @Description: io_uring封装实现, 映射提交/完成队列环, 用带内存序的原子读写与内核交换环的头尾位置
+ * 要求内核支持单次映射、完成事件不丢失以及注册环fd(IORING_FEAT_REG_REG_RING, Linux 6.3+),
+ * 这样多次poll、多次accept和使用缓冲区环的多次recv都一定可用; 不满足时抛出异常, 由调用者退回epoll
+ */
+#include "../include/IoUring.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 较旧的内核头文件中没有该定义(Linux 6.3加入)
+#ifndef IORING_FEAT_REG_REG_RING
+#define IORING_FEAT_REG_REG_RING (1U << 13)
+#endif
+
+static int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+IoUring::IoUring(unsigned entries)
+    : ring_fd(-1), enter_fd(-1), enter_flags(0), sq_ring(nullptr), sq_ring_size(0), sq_head(nullptr),
+      sq_tail(nullptr), sq_mask(0), sq_entries(0), sqes(nullptr), sqes_size(0), sqe_tail(0), cq_ring(nullptr),
+      cq_ring_size(0), cq_head(nullptr), cq_tail(nullptr), cq_mask(0), cqes(nullptr), buf_ring(nullptr),
+      buf_base(nullptr), buf_count(0), buf_size(0), buf_group(0), buf_tail(0)
+{
+    // 多次触发的请求会产生大量完成事件, 完成队列比提交队列大; 只在io_uring_enter时处理完成任务, 减少打断
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * 4;
+
+    ring_fd = ioUringSetup(entries, &params);
+    if (ring_fd == -1)
+    {
+        throw std::runtime_error(std::string("io_uring_setup失败: ") + strerror(errno));
+    }
+
+    const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_REG_REG_RING;
+    if ((params.features & required) != required)
+    {
+        close(ring_fd);
+        throw std::runtime_error("内核不支持所需的io_uring特性(需要Linux 6.3+)");
+    }
+
+    // 提交队列环和完成队列环共用一次映射
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cq_ring_size > sq_ring_size)
+        sq_ring_size = cq_ring_size;
+    cq_ring_size = sq_ring_size;
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        close(ring_fd);
+        throw std::runtime_error("映射io_uring队列失败");
+    }
+    cq_ring = sq_ring;
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes_memory = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                             IORING_OFF_SQES);
+    if (sqes_memory == MAP_FAILED)
+    {
+        munmap(sq_ring, sq_ring_size);
+        close(ring_fd);
+        throw std::runtime_error("映射io_uring提交队列项失败");
+    }
+    sqes = static_cast<struct io_uring_sqe *>(sqes_memory);
+
+    char *sq_base = static_cast<char *>(sq_ring);
+    sq_head = reinterpret_cast<unsigned *>(sq_base + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+    sq_entries = *reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_entries);
+    sqe_tail = *sq_tail;
+
+    // 提交队列项按顺序使用, 下标数组固定为恒等映射
+    unsigned *array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries; ++i)
+    {
+        array[i] = i;
+    }
+
+    char *cq_base = static_cast<char *>(cq_ring);
+    cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq_base + params.cq_off.cqes);
+    enter_fd = ring_fd;
+}
+
+IoUring::~IoUring()
+{
+    // 先关闭实例(取消所有未完成的请求), 再释放内核可能访问的内存
+    close(ring_fd);
+    munmap(sqes, sqes_size);
+    munmap(sq_ring, sq_ring_size);
+    if (buf_ring != nullptr)
+    {
+        munmap(buf_ring, buf_count * sizeof(struct io_uring_buf));
+        munmap(buf_base, static_cast<size_t>(buf_count) * buf_size);
+    }
+}
+
+void IoUring::registerRingFd()
+{
+    // 注册的下标只在注册它的线程中有效; 失败时继续使用普通fd
+    struct io_uring_rsrc_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = -1U;
+    update.data = static_cast<uint64_t>(ring_fd);
+    if (ioUringRegister(ring_fd, IORING_REGISTER_RING_FDS, &update, 1) == 1)
+    {
+        enter_fd = static_cast<int>(update.offset);
+        enter_flags = IORING_ENTER_REGISTERED_RING;
+    }
+}
+
+void IoUring::flush()
+{
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+}
+
+struct io_uring_sqe *IoUring::getSqe()
+{
+    // 没有SQPOLL线程, 内核只在io_uring_enter中消费提交队列, 提交一次即可腾出全部空间
+    if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+    {
+        submitAndWait(0);
+    }
+
+    struct io_uring_sqe *sqe = &sqes[sqe_tail & sq_mask];
+    ++sqe_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUring::submitAndWait(unsigned wait_nr)
+{
+    flush();
+    unsigned to_submit = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit == 0 && wait_nr == 0)
+        return 0;
+
+    unsigned flags = enter_flags;
+    if (wait_nr > 0)
+        flags |= IORING_ENTER_GETEVENTS;
+
+    int ret = ioUringEnter(enter_fd, to_submit, wait_nr, flags);
+    return ret == -1 ? -errno : ret;
+}
+
+bool IoUring::popCompletion(struct io_uring_cqe &cqe)
+{
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    // 复制后立即归还, 处理过程中内核可以继续写入完成事件
+    cqe = cqes[head & cq_mask];
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool IoUring::setupBufferRing(uint16_t group, unsigned count, unsigned size)
+{
+    if (buf_ring != nullptr || count == 0 || (count & (count - 1)) != 0 || count > 32768)
+        return false;
+
+    const size_t ring_bytes = count * sizeof(struct io_uring_buf);
+    void *ring_memory = mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_memory == MAP_FAILED)
+        return false;
+
+    void *buffers = mmap(nullptr, static_cast<size_t>(count) * size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED)
+    {
+        munmap(ring_memory, ring_bytes);
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring_memory);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (ioUringRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        munmap(buffers, static_cast<size_t>(count) * size);
+        munmap(ring_memory, ring_bytes);
+        return false;
+    }
+
+    buf_ring = static_cast<struct io_uring_buf *>(ring_memory);
+    buf_base = static_cast<char *>(buffers);
+    buf_count = count;
+    buf_size = size;
+    buf_group = group;
+    buf_tail = 0;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        recycleBuffer(static_cast<uint16_t>(i));
+    }
+    return true;
+}
+
+void IoUring::recycleBuffer(uint16_t id)
+{
+    struct io_uring_buf *buf = &buf_ring[buf_tail & (buf_count - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(bufferAddress(id));
+    buf->len = buf_size;
+    buf->bid = id;
+
+    // 描述写好之后才推进环尾, 内核看到新的环尾时一定能读到完整的描述; 环尾与第一项的resv字段重叠
+    ++buf_tail;
+    __atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+}
\ No newline at end of file
@@ -0,0 +1,208 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 09:30:18
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 09:30:18
+ * @FilePath: /WebServerByCPP/src/MasterProcess.cpp
+ * @Description: 多进程模式主进程实现, 使用fork创建工作进程、sched_setaffinity绑定CPU、waitpid监控并重启
+ */
+#include "../include/MasterProcess.h"
+#include "../include/HttpServer.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 主进程同步等待的信号: 退出信号和工作进程退出; 平时保持阻塞, 只在sigtimedwait中接收, 检查和等待之间不会丢失
+static void masterSignals(sigset_t *set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGCHLD);
+}
+
+MasterProcess::MasterProcess(unsigned short port, int worker_count, int listen_backlog)
+    : port(port), listen_backlog(listen_backlog), listen_socket(-1), workers(), worker_main()
+{
+    if (worker_count < 1)
+        worker_count = 1;
+
+    // 按主进程允许使用的CPU依次分配, 工作进程多于CPU时循环使用
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        }
+    }
+
+    for (int i = 0; i < worker_count; ++i)
+    {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers.push_back(Worker{-1, cpu, 0});
+    }
+}
+
+MasterProcess::~MasterProcess()
+{
+    if (listen_socket != -1)
+    {
+        close(listen_socket);
+    }
+}
+
+void MasterProcess::spawnWorker(size_t slot)
+{
+    Worker &worker = workers[slot];
+
+    // 避免缓冲区中尚未输出的内容被子进程重复输出
+    std::cout.flush();
+    const pid_t master = getpid();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "创建工作进程失败: " << strerror(errno) << '\n';
+        return;
+    }
+
+    if (pid == 0)
+    {
+        // 工作进程: 恢复默认信号处理并解除主进程阻塞的信号, 主进程退出时随之退出
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        sigset_t signals;
+        masterSignals(&signals);
+        sigprocmask(SIG_UNBLOCK, &signals, nullptr);
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+        // 主进程在fork之后、prctl之前退出时收不到这个信号, 父进程已经变了就直接退出, 不留下无人管理的工作进程
+        if (getppid() != master)
+            _exit(1);
+
+        if (worker.cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(worker.cpu, &set);
+            if (sched_setaffinity(0, sizeof(set), &set) == -1)
+            {
+                std::cerr << "绑定CPU " << worker.cpu << " 失败: " << strerror(errno) << '\n';
+            }
+        }
+
+        int code = 1;
+        try
+        {
+            code = worker_main(listen_socket);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "工作进程错误: " << e.what() << '\n';
+        }
+
+        // 不返回到主进程的代码中, 也不执行主进程对象的析构
+        std::cout.flush();
+        _exit(code);
+    }
+
+    worker.pid = pid;
+    worker.start_time = time(nullptr);
+    std::cout << "工作进程 " << pid << " 已启动 (CPU: " << worker.cpu << ")" << '\n';
+}
+
+void MasterProcess::stopWorkers()
+{
+    for (auto &worker : workers)
+    {
+        if (worker.pid > 0)
+            kill(worker.pid, SIGTERM);
+    }
+
+    for (auto &worker : workers)
+    {
+        if (worker.pid > 0)
+        {
+            while (waitpid(worker.pid, nullptr, 0) == -1 && errno == EINTR)
+            {
+            }
+            worker.pid = -1;
+        }
+    }
+}
+
+int MasterProcess::run(WorkerMain main_function)
+{
+    worker_main = std::move(main_function);
+
+    // 在fork之前创建, 所有工作进程共享同一个监听队列
+    listen_socket = HttpServer::createListenSocket(port, listen_backlog, false);
+    std::cout << "主进程 " << getpid() << " 监听端口 " << port << ", 工作进程数: " << workers.size() << '\n';
+
+    // 阻塞退出信号和SIGCHLD, 之后只在sigtimedwait中同步接收: 在检查和等待之间到达的SIGTERM保持挂起, 不会错过
+    // 阻塞的SIGCHLD即使是默认处理也会保持挂起; 工作进程在fork之后解除阻塞
+    sigset_t signals;
+    masterSignals(&signals);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        spawnWorker(i);
+    }
+
+    while (true)
+    {
+        // 有fork失败的槽位时最多等待1秒后重试, 否则一直等到有信号
+        bool missing = false;
+        for (const auto &worker : workers)
+        {
+            if (worker.pid == -1)
+                missing = true;
+        }
+        const struct timespec retry = {1, 0};
+        const int received = sigtimedwait(&signals, nullptr, missing ? &retry : nullptr);
+        if (received == SIGINT || received == SIGTERM)
+            break;
+
+        // 多个工作进程同时退出时SIGCHLD只挂起一次, 回收所有已退出的进程
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            for (auto &worker : workers)
+            {
+                if (worker.pid != pid)
+                    continue;
+
+                if (WIFSIGNALED(status))
+                    std::cerr << "工作进程 " << pid << " 被信号 " << WTERMSIG(status) << " 终止" << '\n';
+                else
+                    std::cerr << "工作进程 " << pid << " 退出, 退出码 " << WEXITSTATUS(status) << '\n';
+                worker.pid = -1;
+
+                // 启动后立即退出的进程(例如配置错误)不要无间隔地反复重启; 期间到达的退出信号保持挂起
+                if (time(nullptr) - worker.start_time < 1)
+                    sleep(1);
+            }
+        }
+
+        // 重启已退出或之前fork失败的工作进程
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            if (workers[i].pid == -1)
+                spawnWorker(i);
+        }
+    }
+
+    std::cout << "主进程收到退出信号, 停止所有工作进程" << '\n';
+    stopWorkers();
+    return 0;
+}
\ No newline at end of file
@@ -6,59 +6,127 @@
  * @FilePath: /WebServerByCPP/src/RequestHandler.cpp
  * 包含RequestHandler基类及StaticFileHandler和CgiHandler两个子类
  * StaticFileHandler负责读取和发送静态文件内容，实现了基本的HTTP静态资源服务
+ * 静态文件以open/fstat获取大小后交给连接以sendfile发送, 不经过用户空间缓冲区
+ * 启用文件缓存时小文件从共享的内存缓存中发送, 未命中时读入缓存
  * CgiHandler实现了CGI脚本执行机制，支持GET和POST方法，使用管道进行进程间通信
- * 针对Linux/Unix系统优化，使用fork()和exec()实现CGI脚本执行
+ * CGI只在执行器的协程中运行: 管道为非阻塞, 写入请求体和读取输出时在事件循环上挂起, 任何线程都不会阻塞在脚本上
+ * 脚本有运行时限和输出大小上限, 超出时以pidfd发送SIGKILL并返回504/502; 等待脚本退出也是等待pidfd可读, 不轮询
+ * CGI输出收集完整后按脚本给出的头部重新组装响应, 补全Content-Length以便在持久连接上发送
+ * 管道按请求体大小扩容, 请求体和输出都以大块读写; 输出直接读入缓冲区, 读入时查找头部结束的空行, 正文整块移入连接的输出队列
+ * 针对Linux/Unix系统优化，CGI脚本由启动时fork的辅助进程预先fork的子进程exec, 辅助进程不可用时以posix_spawn()启动
+ * 脚本的环境变量是预先生成的CGI/1.1元变量, 与FastCGI参数由同一个函数生成
+ * FastCgiHandler把请求字段映射为FastCGI参数, 通过执行器线程的连接池发给常驻后端, 输出按CGI输出同样处理
  * 通过工厂方法根据请求类型自动创建合适的处理器实例
  */
 #include "../include/RequestHandler.h"
+#include "../include/AsyncIo.h"
+#include "../include/Buffer.h"
+#include "../include/CgiSpawner.h"
+#include "../include/FastCgi.h"
+#include "../include/FileCache.h"
+#include "../include/HttpConnection.h"
 #include "../include/HttpResponse.h"
+#include <algorithm>
+#include <csignal>
 #include <arpa/inet.h>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <netinet/in.h>
+#include <spawn.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <vector>
 const char PATH_SEP = '/';
 
+static const int CGI_PIPE_SIZE = 256 * 1024;      // CGI输出管道的容量, 脚本不必等待服务器读取就能写完常见大小的输出
+static const size_t DEFAULT_PIPE_SIZE = 64 * 1024; // 管道的默认容量, 请求体超过它时扩大输入管道
+
+// pidfd系统调用; 直接调用syscall, 不依赖C库的包装函数
+static int pidfdOpen(pid_t pid)
+{
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+static void pidfdKill(int pid_fd)
+{
+    syscall(SYS_pidfd_send_signal, pid_fd, SIGKILL, nullptr, 0);
+}
+
 // 基类构造函数
 RequestHandler::RequestHandler(const std::string &root) : doc_root(root)
 {
 }
 
+// 默认的协程版本直接同步处理
+Task<void> RequestHandler::handleAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &)
+{
+    handle(request, conn);
+    co_return;
+}
+
 // 工厂方法：根据请求类型创建处理器
 std::unique_ptr<RequestHandler> RequestHandler::createHandler(const HttpRequest &request)
 {
-    if (request.isCgi())
+    if (request.getFastCgiBackend() != nullptr)
+    {
+        return std::make_unique<FastCgiHandler>(std::string(request.getDocRoot()), *request.getFastCgiBackend());
+    }
+    else if (request.isCgi())
     {
-        return std::make_unique<CgiHandler>(request.getDocRoot());
+        return std::make_unique<CgiHandler>(std::string(request.getDocRoot()));
     }
     else
     {
-        return std::make_unique<StaticFileHandler>(request.getDocRoot());
+        return std::make_unique<StaticFileHandler>(std::string(request.getDocRoot()), request.getFileCache());
     }
 }
 
 // StaticFileHandler实现
-StaticFileHandler::StaticFileHandler(const std::string &root) : RequestHandler(root)
+StaticFileHandler::StaticFileHandler(const std::string &root, FileCache *cache) : RequestHandler(root), file_cache(cache)
 {
 }
 
-void StaticFileHandler::handle(const HttpRequest &request, int client_socket)
+void StaticFileHandler::handle(const HttpRequest &request, HttpConnection &conn)
 {
     // 不要再次拼接路径，直接使用HttpRequest中处理好的路径
     std::string fullPath = request.getPath();
 
     // 处理静态文件
-    serveFile(fullPath, client_socket);
+    serveFile(fullPath, conn);
 }
 
-void StaticFileHandler::serveFile(const std::string &path, int client_socket)
+void StaticFileHandler::serveFile(const std::string &path, HttpConnection &conn)
 {
-    FILE *resource = fopen(path.c_str(), "r");
+    // 热点文件直接从内存发送预先生成的响应头和文件内容
+    if (file_cache != nullptr)
+    {
+        std::shared_ptr<const FileCache::Entry> entry = file_cache->get(path);
+        if (entry == nullptr)
+            entry = file_cache->load(path);
+        if (entry != nullptr)
+        {
+            conn.send(conn.isKeepAlive() ? entry->head_keep_alive : entry->head_close);
+            conn.send(entry->content);
+            return;
+        }
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd != -1 && (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)))
+    {
+        close(fd);
+        fd = -1;
+    }
 
 #ifdef DEBUG
     std::cout << "========== StaticFileHandler::serveFile Debug Info ==========" << '\n';
@@ -66,7 +134,7 @@ void StaticFileHandler::serveFile(const std::string &path, int client_socket)
     std::cout << "========== StaticFileHandler::serveFile Debug Info End ==========" << '\n';
 #endif
 
-    if (resource == nullptr)
+    if (fd == -1)
     {
         // 获取当前工作目录
         char cwd[1024];
@@ -77,16 +145,151 @@ void StaticFileHandler::serveFile(const std::string &path, int client_socket)
         }
 
         // 文件不存在，返回404
-        HttpResponse response = HttpResponse::notFound();
-        response.send(client_socket);
+        HttpResponse::sendError(conn, 404);
         return;
     }
 
-    // 文件存在，发送文件内容
+    // 文件存在，发送文件内容, fd交给连接在发送完毕后关闭
     HttpResponse response = HttpResponse::ok();
-    response.sendFile(client_socket, resource);
+    response.sendFile(conn, fd, st.st_size);
+}
+
+// 把CGI脚本输出的头部合并到响应中, Status头设置状态码, 长度和连接相关的头部由服务器生成
+static void applyCgiHeaders(const std::string &block, HttpResponse &response)
+{
+    size_t pos = 0;
+    while (pos < block.size())
+    {
+        size_t eol = block.find('\n', pos);
+        if (eol == std::string::npos)
+            eol = block.size();
+        std::string line = block.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+
+        std::string name = line.substr(0, colon);
+        size_t value_start = line.find_first_not_of(" \t", colon + 1);
+        std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+
+        if (strcasecmp(name.c_str(), "Status") == 0)
+        {
+            // 格式为"Status: 404 Not Found"
+            int code = atoi(value.c_str());
+            size_t space = value.find(' ');
+            if (code >= 100 && code < 600)
+                response.setStatus(code, space == std::string::npos ? "" : value.substr(space + 1));
+        }
+        else if (strcasecmp(name.c_str(), "Content-Type") == 0)
+        {
+            response.addHeader("Content-Type", value);
+        }
+        else if (strcasecmp(name.c_str(), "Content-Length") != 0 && strcasecmp(name.c_str(), "Connection") != 0)
+        {
+            response.addHeader(name, value);
+        }
+    }
+}
+
+// 取得socket地址的IP和端口, 失败时返回false
+static bool socketAddress(const struct sockaddr_storage &addr, std::string &ip, std::string &port)
+{
+    char text[INET6_ADDRSTRLEN];
+    if (addr.ss_family == AF_INET)
+    {
+        const struct sockaddr_in *in = reinterpret_cast<const struct sockaddr_in *>(&addr);
+        inet_ntop(AF_INET, &in->sin_addr, text, sizeof(text));
+        port = std::to_string(ntohs(in->sin_port));
+    }
+    else if (addr.ss_family == AF_INET6)
+    {
+        const struct sockaddr_in6 *in6 = reinterpret_cast<const struct sockaddr_in6 *>(&addr);
+        inet_ntop(AF_INET6, &in6->sin6_addr, text, sizeof(text));
+        port = std::to_string(ntohs(in6->sin6_port));
+    }
+    else
+    {
+        return false;
+    }
+    ip = text;
+    return true;
+}
+
+// 按CGI/1.1(RFC 3875)生成请求的元变量, 对每个变量调用add(名称, 值), 其他请求头转为HTTP_前缀的变量
+// CGI脚本的环境变量和FastCGI参数都由此生成; socket为客户端连接, 用于取得双方的地址和端口
+template <typename AddVariable>
+static void forEachCgiVariable(const HttpRequest &request, int socket, AddVariable add)
+{
+    std::string_view script_name = request.getScriptName();
+    std::string request_uri(request.getUrl());
+    if (!request.getQueryString().empty())
+    {
+        request_uri += '?';
+        request_uri.append(request.getQueryString());
+    }
+
+    add("GATEWAY_INTERFACE", "CGI/1.1");
+    add("SERVER_SOFTWARE", "NoWorld's http/0.1.0");
+    add("SERVER_PROTOCOL", request.getVersion().empty() ? "HTTP/1.0" : request.getVersion());
+    add("REQUEST_METHOD", request.getMethod());
+    add("REQUEST_URI", request_uri);
+    add("SCRIPT_NAME", script_name);
+    add("SCRIPT_FILENAME", request.getPath());
+    add("DOCUMENT_ROOT", request.getDocRoot());
+    add("QUERY_STRING", request.getQueryString());
+    // 没有请求体时不设置CONTENT_LENGTH, 没有类型时不设置CONTENT_TYPE
+    if (request.getMethod() == "POST")
+        add("CONTENT_LENGTH", std::to_string(request.getBody().size()));
+    if (!request.getHeader("content-type").empty())
+        add("CONTENT_TYPE", request.getHeader("content-type"));
+
+    // 主机名取自Host头, 去掉端口部分
+    std::string_view host = request.getHeader("host");
+    size_t colon = host.rfind(':');
+    if (colon != std::string_view::npos && host.find(']', colon) == std::string_view::npos)
+        host = host.substr(0, colon);
+    add("SERVER_NAME", host);
+
+    struct sockaddr_storage addr;
+    socklen_t length = sizeof(addr);
+    std::string ip;
+    std::string port;
+    if (getpeername(socket, reinterpret_cast<struct sockaddr *>(&addr), &length) == 0 &&
+        socketAddress(addr, ip, port))
+    {
+        add("REMOTE_ADDR", ip);
+        add("REMOTE_PORT", port);
+    }
+    length = sizeof(addr);
+    if (getsockname(socket, reinterpret_cast<struct sockaddr *>(&addr), &length) == 0 &&
+        socketAddress(addr, ip, port))
+    {
+        add("SERVER_ADDR", ip);
+        add("SERVER_PORT", port);
+    }
 
-    fclose(resource);
+    // Content-Type和Content-Length已作为CGI参数传递; Proxy头会变成应用当作代理设置的HTTP_PROXY, 不转发
+    // 其余头部名称转为大写并把'-'换为'_'
+    std::string name;
+    for (size_t i = 0; i < request.getHeaderCount(); ++i)
+    {
+        std::string_view header = request.getHeaderName(i);
+        if ((header.size() == 12 && strncasecmp(header.data(), "content-type", 12) == 0) ||
+            (header.size() == 14 && strncasecmp(header.data(), "content-length", 14) == 0) ||
+            (header.size() == 5 && strncasecmp(header.data(), "proxy", 5) == 0))
+            continue;
+
+        name.assign("HTTP_");
+        for (char c : header)
+        {
+            name += c == '-' ? '_' : static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+        add(name, request.getHeaderValue(i));
+    }
 }
 
 // CgiHandler实现
@@ -94,165 +297,484 @@ CgiHandler::CgiHandler(const std::string &root) : RequestHandler(root)
 {
 }
 
-void CgiHandler::handle(const HttpRequest &request, int client_socket)
+int CgiHandler::timeout_ms = 30 * 1000;
+size_t CgiHandler::max_output = 64 * 1024 * 1024;
+
+void CgiHandler::setLimits(int timeout_seconds, size_t max_output_bytes)
 {
-    // 不要再次拼接路径，直接使用HttpRequest中处理好的路径
-    std::string path = request.getPath();
-    executeCgi(request, client_socket, path);
+    timeout_ms = timeout_seconds > 0 ? timeout_seconds * 1000 : 0;
+    max_output = max_output_bytes;
 }
 
-void CgiHandler::executeCgi(const HttpRequest &request, int client_socket, std::string path)
+void CgiHandler::handle(const HttpRequest &, HttpConnection &conn)
 {
-    const std::string &method = request.getMethod();
-    const std::string &query_string = request.getQueryString();
+    // 同步处理会让线程阻塞在脚本上; CGI请求总是在执行器中处理, 不会到达这里
+    HttpResponse::sendError(conn, 500);
+}
 
-    int cgi_output[2];
-    int cgi_input[2];
-    pid_t pid;
-    int status;
-    int content_length = -1; // 检查Content-Length（如果是POST请求）
-    if (method == "POST")
+Task<void> CgiHandler::handleAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop)
+{
+    co_await executeCgiAsync(request, conn, loop);
+}
+
+// 取得POST请求的Content-Length, GET请求为-1; POST缺少该头部时返回false
+static bool cgiContentLength(const HttpRequest &request, int &content_length)
+{
+    content_length = -1;
+    if (request.getMethod() != "POST")
+        return true;
+
+    std::string contentLength(request.getHeader("content-length"));
+    if (contentLength.empty())
+        return false;
+    content_length = std::stoi(contentLength);
+    return true;
+}
+
+// 查找CGI输出中头部和正文之间的空行(\n\n或\n\r\n), 从scanned开始检查, 已检查过的字节不再检查
+// 找到时返回头部长度(不含最后一行的换行符)并设置body_start; 否则返回npos, scanned为下次开始检查的位置
+static size_t findCgiHeaderEnd(const char *data, size_t size, size_t &scanned, size_t &body_start)
+{
+    // 输出以空行开头时没有头部
+    if (scanned == 0 && size > 0)
     {
-        std::string contentLength = request.getHeader("content-length");
-        if (!contentLength.empty())
+        if (data[0] == '\n')
         {
-            content_length = std::stoi(contentLength);
+            body_start = 1;
+            return 0;
         }
-        else
+        if (data[0] == '\r' && size == 1)
+            return std::string::npos;
+        if (data[0] == '\r' && data[1] == '\n')
         {
-            // 缺少Content-Length，返回400
-            HttpResponse response = HttpResponse::badRequest();
-            response.send(client_socket);
-            return;
+            body_start = 2;
+            return 0;
         }
     }
 
-    // 发送HTTP响应状态行
+    for (size_t i = scanned; i < size; ++i)
+    {
+        if (data[i] != '\n')
+            continue;
+        // 换行符之后的字节还没有读到, 下次从这个换行符开始
+        if (i + 1 == size || (data[i + 1] == '\r' && i + 2 == size))
+        {
+            scanned = i;
+            return std::string::npos;
+        }
+        if (data[i + 1] == '\n')
+        {
+            body_start = i + 2;
+            return i;
+        }
+        if (data[i + 1] == '\r' && data[i + 2] == '\n')
+        {
+            body_start = i + 3;
+            return i;
+        }
+    }
+    scanned = size;
+    return std::string::npos;
+}
+
+// 按脚本输出的头部组装响应头并写入连接, 响应体由调用者随后写入; header_end为npos时没有头部
+static void sendCgiHead(const char *output, size_t header_end, size_t body_length, HttpConnection &conn)
+{
     HttpResponse response = HttpResponse::ok();
+    if (header_end != std::string::npos)
+        applyCgiHeaders(std::string(output, header_end), response);
+
+    // 脚本给出的Content-Length已被忽略, 按实际正文长度生成; 响应体为空, send只写入头部
+    response.addHeader("Content-Length", std::to_string(body_length));
+    response.send(conn);
+}
 
-    // 创建管道
-    if (pipe(cgi_output) < 0 || pipe(cgi_input) < 0)
+// 按FastCGI应用的输出组装响应并写入连接; 头部和正文之间以空行分隔, 没有空行时全部作为正文
+static void sendCgiOutput(const std::string &output, HttpConnection &conn)
+{
+    size_t scanned = 0;
+    size_t body_start = 0;
+    const size_t header_end = findCgiHeaderEnd(output.data(), output.size(), scanned, body_start);
+
+    sendCgiHead(output.data(), header_end, output.size() - body_start, conn);
+    if (body_start < output.size())
+        conn.send(output.data() + body_start, output.size() - body_start);
+}
+
+// CGI脚本的输出: 以Buffer::readFd直接读入缓冲区, 一次读取管道中的全部数据
+// 每次读入后只在新数据中查找头部结束的空行, 找到后不再查找; 发送时正文所在的缓冲区整体移入连接, 不再复制
+class CgiOutput
+{
+  private:
+    Buffer data;
+    size_t scanned;    // 已查找过空行的字节数
+    size_t header_end; // 头部长度, 尚未找到空行时为npos
+    size_t body_start; // 正文在data中的起始位置
+
+  public:
+    CgiOutput() : scanned(0), header_end(std::string::npos), body_start(0)
     {
-        response = HttpResponse::serverError();
-        response.send(client_socket);
-        return;
     }
 
-    // 创建子进程
-    if ((pid = fork()) < 0)
+    // 已读取的字节数
+    size_t size() const
     {
-        // 关闭管道再返回
-        close(cgi_output[0]);
-        close(cgi_output[1]);
-        close(cgi_input[0]);
-        close(cgi_input[1]);
+        return data.readableBytes();
+    }
 
-        response = HttpResponse::serverError();
-        response.send(client_socket);
-        return;
+    // 从fd读取一次, 返回值与Buffer::readFd相同
+    ssize_t readFrom(int fd, int *saved_errno)
+    {
+        ssize_t n = data.readFd(fd, saved_errno);
+        if (n > 0 && header_end == std::string::npos)
+            header_end = findCgiHeaderEnd(data.peek(), data.readableBytes(), scanned, body_start);
+        return n;
+    }
+
+    // 按头部组装响应并写入连接; 没有空行时全部作为正文
+    void send(HttpConnection &conn)
+    {
+        sendCgiHead(data.peek(), header_end, data.readableBytes() - body_start, conn);
+        data.retrieve(body_start);
+        conn.send(std::move(data));
     }
+};
 
-    if (pid == 0)
-    { // 子进程运行CGI脚本
-        std::string meth_env;
-        std::string query_env;
-        std::string length_env;
+bool CgiHandler::startCgi(const HttpRequest &request, const std::string &path, int client_socket, CgiProcess &process)
+{
+    // 环境变量在父进程中一次生成: CGI/1.1元变量加上服务器的PATH, 不继承服务器的其他环境变量
+    std::vector<std::string> env;
+    forEachCgiVariable(request, client_socket, [&env](std::string_view name, std::string_view value) {
+        std::string entry;
+        entry.reserve(name.size() + value.size() + 1);
+        entry.append(name).append(1, '=').append(value);
+        env.push_back(std::move(entry));
+    });
+    const char *search_path = getenv("PATH");
+    if (search_path != nullptr)
+        env.push_back(std::string("PATH=") + search_path);
 
-        // 重定向标准输入/输出
-        dup2(cgi_output[1], STDOUT_FILENO);
-        dup2(cgi_input[0], STDIN_FILENO);
+    int cgi_output[2];
+    int cgi_input[2];
 
-        // 关闭不需要的管道端
+    // 创建管道; 设置close-on-exec, 其他请求的子进程不会继承这些管道
+    if (pipe2(cgi_output, O_CLOEXEC) < 0)
+        return false;
+    if (pipe2(cgi_input, O_CLOEXEC) < 0)
+    {
         close(cgi_output[0]);
-        close(cgi_input[1]);
+        close(cgi_output[1]);
+        return false;
+    }
 
-        // 设置环境变量
-        meth_env = "REQUEST_METHOD=" + method;
-        putenv(strdup(meth_env.c_str()));
+    // 扩大管道: 输出以大块读取, 较大的请求体一次写入; 超出系统上限(pipe-max-size)时保持原容量
+    fcntl(cgi_output[0], F_SETPIPE_SZ, CGI_PIPE_SIZE);
+    const size_t body_size = request.getBody().size();
+    if (body_size > DEFAULT_PIPE_SIZE)
+        fcntl(cgi_input[1], F_SETPIPE_SZ, static_cast<int>(std::min(body_size, static_cast<size_t>(CGI_PIPE_SIZE))));
+
+    // 只有父进程一端设为非阻塞, 子进程的标准输入/输出保持阻塞
+    fcntl(cgi_output[0], F_SETFL, fcntl(cgi_output[0], F_GETFL) | O_NONBLOCK);
+    fcntl(cgi_input[1], F_SETFL, fcntl(cgi_input[1], F_GETFL) | O_NONBLOCK);
+
+    // 优先交给CGI辅助进程启动, 脚本不是本进程的子进程, 不需要回收; 脚本通过report[1]发回自己的pidfd
+    pid_t pid = -1;
+    int pid_fd = -1;
+    int report[2] = {-1, -1};
+    if (CgiSpawner::isAvailable() &&
+        socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, report) == 0 &&
+        fcntl(report[0], F_SETFL, O_NONBLOCK) == 0 &&
+        CgiSpawner::spawn(path, env, cgi_input[0], cgi_output[1], report[1]))
+    {
+        close(report[1]);
+    }
+    else
+    {
+        if (report[0] != -1)
+        {
+            close(report[0]);
+            close(report[1]);
+            report[0] = -1;
+        }
 
-        if (method == "GET")
+        // 辅助进程不可用时以posix_spawn启动: 子进程在exec之前与服务器共享地址空间(vfork语义),
+        // 不复制页表, 启动开销不随服务器内存增长; 文件操作把管道dup2为标准输入/输出, dup2得到的fd不带close-on-exec
+        std::vector<char *> envp;
+        envp.reserve(env.size() + 1);
+        for (auto &item : env)
         {
-            query_env = "QUERY_STRING=" + query_string;
-            putenv(strdup(query_env.c_str()));
+            envp.push_back(item.data());
         }
-        else
-        { // POST
-            length_env = "CONTENT_LENGTH=" + std::to_string(content_length);
-            putenv(strdup(length_env.c_str()));
+        envp.push_back(nullptr);
+        char *argv[] = {const_cast<char *>(path.c_str()), nullptr};
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, cgi_output[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, cgi_input[0], STDIN_FILENO);
+
+        // 服务器忽略SIGPIPE, 脚本恢复默认处理; 不继承调用线程的信号屏蔽字
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t signals;
+        sigemptyset(&signals);
+        posix_spawnattr_setsigmask(&attr, &signals);
+        sigaddset(&signals, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attr, &signals);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        int rc = posix_spawn(&pid, path.c_str(), &actions, &attr, argv, envp.data());
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        if (rc != 0)
+        {
+            // exec失败(例如脚本不可执行)也在这里返回
+            std::cerr << "启动CGI脚本失败: " << path << ": " << strerror(rc) << '\n';
+            close(cgi_output[0]);
+            close(cgi_output[1]);
+            close(cgi_input[0]);
+            close(cgi_input[1]);
+            return false;
         }
 
-        // 执行CGI脚本
-        execl(path.c_str(), path.c_str(), nullptr);
-        exit(0);
+        // 子进程尚未回收, pid不会被复用, 此时取得的pidfd一定指向它
+        pid_fd = pidfdOpen(pid);
     }
-    else
-    { // 父进程
-        close(cgi_output[1]);
-        close(cgi_input[0]);
 
-        // 如果是POST请求，将请求体发送给CGI脚本
-        if (method == "POST")
+    // 父进程关闭子进程一端
+    close(cgi_output[1]);
+    close(cgi_input[0]);
+
+    process.pid = pid;
+    process.script_pid = -1;
+    process.pid_fd = pid_fd;
+    process.report_fd = report[0];
+    process.input_fd = cgi_input[1];
+    process.output_fd = cgi_output[0];
+    return true;
+}
+
+Task<void> CgiHandler::executeCgiAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop)
+{
+    int content_length;
+    if (!cgiContentLength(request, content_length))
+    {
+        HttpResponse::sendError(conn, 400);
+        co_return;
+    }
+
+    // 运行时限从启动脚本开始计算, 覆盖写入请求体、读取输出和等待退出
+    const auto deadline = timeout_ms > 0
+                              ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)
+                              : std::chrono::steady_clock::time_point::max();
+
+    // 不要再次拼接路径，直接使用HttpRequest中处理好的路径
+    CgiProcess process;
+    if (!startCgi(request, request.getPath(), conn.getSocket(), process))
+    {
+        HttpResponse::sendError(conn, 500);
+        co_return;
+    }
+
+    // 超出限制时返回给客户端的状态码: 超时504, 输出过大502
+    int error_status = 0;
+
+    // 写入请求体, 管道已满时挂起; 脚本提前退出时忽略剩余部分
+    if (content_length >= 0)
+    {
+        std::string_view body = request.getBody();
+        size_t body_len = std::min(body.size(), static_cast<size_t>(content_length));
+        size_t written = 0;
+        while (written < body_len)
         {
-            // 这部分需要用真实的请求体数据替换
-            // 简化实现，实际中应从socket读取
-            char c;
-            for (int i = 0; i < content_length; i++)
+            ssize_t n = write(process.input_fd, body.data() + written, body_len - written);
+            if (n > 0)
             {
-                if (recv(client_socket, &c, 1, 0) > 0)
-                {
-                    write(cgi_input[1], &c, 1);
-                }
+                written += static_cast<size_t>(n);
+                continue;
+            }
+            if (n == -1 && errno == EINTR)
+                continue;
+            if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+                break;
+            if (co_await waitWritableUntil(loop, process.input_fd, deadline) == 0)
+            {
+                error_status = 504;
+                break;
             }
         }
+    }
+    close(process.input_fd);
+
+    // 读取全部输出, 没有数据时挂起
+    CgiOutput output;
+    while (error_status == 0)
+    {
+        int saved_errno = 0;
+        ssize_t n = output.readFrom(process.output_fd, &saved_errno);
+        if (n > 0)
+        {
+            if (max_output > 0 && output.size() > max_output)
+                error_status = 502;
+            continue;
+        }
+        if (n < 0 && saved_errno == EINTR)
+            continue;
+        if (n < 0 && (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK))
+        {
+            if (co_await waitReadableUntil(loop, process.output_fd, deadline) == 0)
+                error_status = 504;
+            continue;
+        }
+        break;
+    }
+    close(process.output_fd);
+
+    // exec失败时子进程报告后退出, 输出为空; 与posix_spawn失败时一样返回500
+    const bool launched = receiveReport(process);
+    if (error_status == 0 && !launched)
+    {
+        HttpResponse::sendError(conn, 500);
+    }
+    else if (error_status != 0)
+    {
+        std::cerr << (error_status == 504 ? "CGI脚本超时" : "CGI脚本输出过大") << ", 已终止: " << request.getPath()
+                  << '\n';
+        killCgi(process);
+        HttpResponse::sendError(conn, error_status);
+    }
+    else
+    {
+        output.send(conn);
+    }
 
-        // 从CGI脚本读取输出并发送给客户端
-        // 首先发送HTTP响应头
-        std::string status_line = "HTTP/1.0 200 OK\r\n";
-        send(client_socket, status_line.c_str(), status_line.length(), 0);
+    // 关闭输出后脚本可能还没有退出, 由独立的协程等待和回收, 到期时终止, 不推迟本请求的完成
+    // 已超出限制而报告还没有到达时, 报告一到达就终止脚本
+    if (!cgiExited(process))
+        spawnTask(reapCgi(loop, process, error_status != 0 ? std::chrono::steady_clock::now() : deadline));
+    else if (process.pid_fd != -1)
+        close(process.pid_fd);
+}
 
-        // 读取CGI输出并发送给客户端
-        char c;
-        bool headers_sent = false;
-        std::string header_buffer;
+bool CgiHandler::receiveReport(CgiProcess &process)
+{
+    // 脚本在exec之前发回报告, exec失败的报告在子进程退出之前发出, 读到输出的EOF时都已到达
+    // 超时时报告可能还没有到达, 此时脚本还没有开始运行
+    if (process.report_fd == -1)
+        return true;
+    const CgiSpawner::Launch launch = CgiSpawner::receiveReport(process.report_fd, process.script_pid, process.pid_fd);
+    if (launch != CgiSpawner::Launch::Pending)
+    {
+        close(process.report_fd);
+        process.report_fd = -1;
+    }
+    return launch != CgiSpawner::Launch::Failed;
+}
 
-        while (read(cgi_output[0], &c, 1) > 0)
+void CgiHandler::killCgi(CgiProcess &process)
+{
+    // pidfd总是指向启动的那个进程, 即使它已经退出也不会误杀复用了pid的其他进程
+    if (process.pid_fd != -1)
+        pidfdKill(process.pid_fd);
+    else if (process.pid > 0)
+        kill(process.pid, SIGKILL); // 本进程的子进程在回收之前pid不会被复用
+    else if (process.script_pid > 0)
+        kill(process.script_pid, SIGKILL); // 内核不支持pidfd时只能按pid终止, 脚本刚刚还在输出, pid尚未被复用
+}
+
+bool CgiHandler::cgiExited(CgiProcess &process)
+{
+    int status;
+    if (process.pid > 0)
+        return waitpid(process.pid, &status, WNOHANG) != 0;
+    if (process.report_fd != -1)
+        return false;
+    if (process.pid_fd != -1)
+    {
+        struct pollfd exited = {process.pid_fd, POLLIN, 0};
+        return poll(&exited, 1, 0) == 1;
+    }
+    // 由辅助进程启动的脚本由内核回收, 没有pidfd时按pid检查
+    return process.script_pid <= 0 || kill(process.script_pid, 0) == -1;
+}
+
+Task<void> CgiHandler::reapCgi(EventLoop &loop, CgiProcess process, std::chrono::steady_clock::time_point deadline)
+{
+    // 脚本还没有取得请求: 报告到达(或各端关闭)之后才能终止它, 期限已过时随后立即终止
+    while (process.report_fd != -1)
+    {
+        co_await waitReadable(loop, process.report_fd);
+        receiveReport(process);
+    }
+
+    const pid_t pid = process.pid;
+    const int pid_fd = process.pid_fd;
+    int status;
+    if (pid_fd == -1 && pid <= 0)
+    {
+        // 由辅助进程启动且内核不支持pidfd: 脚本不是本进程的子进程, 只能按pid定期检查, 到期时终止一次
+        while (process.script_pid > 0 && kill(process.script_pid, 0) == 0)
         {
-            if (!headers_sent)
+            if (std::chrono::steady_clock::now() >= deadline)
             {
-                header_buffer += c;
-
-                // 查找头部结束标记（空行）
-                if (header_buffer.find("\r\n\r\n") != std::string::npos ||
-                    header_buffer.find("\n\n") != std::string::npos)
-                {
-                    // 直接发送CGI脚本生成的头部和正文
-                    send(client_socket, header_buffer.c_str(), header_buffer.length(), 0);
-                    headers_sent = true;
-                }
+                kill(process.script_pid, SIGKILL);
+                break;
             }
-            else
+            co_await sleepFor(loop, CGI_REAP_INTERVAL_MS);
+        }
+        co_return;
+    }
+
+    if (pid_fd == -1)
+    {
+        // 内核不支持pidfd时定期检查; 子进程回收之前pid不会被复用, 到期时可以直接kill
+        bool killed = false;
+        while (waitpid(pid, &status, WNOHANG) == 0)
+        {
+            if (!killed && std::chrono::steady_clock::now() >= deadline)
             {
-                // 继续发送正文
-                send(client_socket, &c, 1, 0);
+                kill(pid, SIGKILL);
+                killed = true;
             }
+            co_await sleepFor(loop, CGI_REAP_INTERVAL_MS);
         }
+        co_return;
+    }
 
-        // 如果没有找到头部结束标记，将缓冲区内容作为正文发送
-        if (!headers_sent && !header_buffer.empty())
-        {
-            // 添加默认头部和空行
-            std::string default_headers = "Content-Type: text/html\r\n\r\n";
-            send(client_socket, default_headers.c_str(), default_headers.length(), 0);
+    // 进程退出时pidfd变为可读; 关闭输出后仍运行到期限的脚本被终止
+    if (co_await waitReadableUntil(loop, pid_fd, deadline) == 0)
+    {
+        pidfdKill(pid_fd);
+        co_await waitReadable(loop, pid_fd);
+    }
+    if (pid > 0)
+        waitpid(pid, &status, WNOHANG);
+    close(pid_fd);
+}
+// FastCgiHandler实现
+FastCgiHandler::FastCgiHandler(const std::string &root, const FastCgiBackend &backend)
+    : RequestHandler(root), backend(backend)
+{
+}
 
-            // 发送缓冲区内容作为正文
-            send(client_socket, header_buffer.c_str(), header_buffer.length(), 0);
-        }
+void FastCgiHandler::handle(const HttpRequest &, HttpConnection &conn)
+{
+    // 连接池属于执行器线程, 动态请求总是在执行器中处理, 不会到达这里
+    HttpResponse::sendError(conn, 500);
+}
 
-        // 关闭管道
-        close(cgi_output[0]);
-        close(cgi_input[1]);
+Task<void> FastCgiHandler::handleAsync(const HttpRequest &request, HttpConnection &conn, EventLoop &loop)
+{
+    FastCgiParams params;
+    forEachCgiVariable(request, conn.getSocket(),
+                       [&params](std::string_view name, std::string_view value) { params.add(name, value); });
 
-        // 等待子进程结束
-        waitpid(pid, &status, 0);
+    // 后端不可用时返回502, 超时返回504, 后端过载时返回503
+    FastCgiResult result = co_await fastCgiRequest(loop, backend, params, request.getBody());
+    if (result.error_status != 0)
+    {
+        HttpResponse::sendError(conn, result.error_status);
+        co_return;
     }
+    sendCgiOutput(result.output, conn);
 }
\ No newline at end of file
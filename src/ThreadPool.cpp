@@ -0,0 +1,472 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-16 11:12:50
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 16:12:40
+ * @FilePath: /WebServerByCPP/src/ThreadPool.cpp
+ * @Description: 工作线程池实现, 全局注入队列加每线程的工作窃取队列, 空闲线程自旋后在各自的eventfd上休眠
+ * 取任务的顺序: 本地队列 -> 注入队列 -> 窃取其他线程; 每执行一定数量的任务先查看注入队列, 避免其中的任务饿死
+ * 队列中保存堆上分配的任务指针, 窃取者只有CAS成功后才取得任务的所有权
+ * 休眠与唤醒: 工作线程先标记休眠再检查所有队列, 提交者先放入任务再查找休眠的线程, 两侧之间都有全序屏障,
+ * 因此二者至少有一方能看到对方的修改, 不会出现任务已入队而所有线程都在休眠的情况
+ * 休眠标记只能被一方(唤醒者或线程自己)用exchange清除, 清除它的唤醒者必须写eventfd, 线程自己清除时不再读取
+ * 缩容时先设置退出标志再尝试认领休眠标记, 与休眠前的检查同样配对; 退出的线程如果带走了一次唤醒, 会把它转交给其他线程
+ */
+#include "../include/ThreadPool.h"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// 当前线程所属的线程池和编号, 用于把工作线程提交的任务放入它的本地队列
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+// 自旋等待时提示CPU当前处于忙等状态
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// 线程数固定时上下限相同, 不会伸缩
+static ThreadPool::ResizePolicy fixedPolicy(size_t thread_count)
+{
+    ThreadPool::ResizePolicy policy;
+    policy.min_threads = thread_count;
+    policy.max_threads = thread_count;
+    policy.grow_wait_us = 0;
+    policy.shrink_utilization = 0;
+    policy.grow_samples = 1;
+    policy.shrink_samples = 1;
+    return policy;
+}
+
+ThreadPool::ThreadPool(size_t thread_count, size_t max_queue_size)
+    : ThreadPool(thread_count, max_queue_size, fixedPolicy(thread_count))
+{
+}
+
+ThreadPool::ThreadPool(size_t thread_count, size_t max_queue_size, const ResizePolicy &resize_policy)
+    : workers(), max_workers(0), injection(max_queue_size), states(), slot_count(0), live_workers(0),
+      idle_workers(0), next_sleeper(0), stopping(false), spin_count(0), active_tasks(0), completed_tasks(0),
+      rejected_tasks(0), resize_mutex(), policy(resize_policy), last_sample_time(Clock::now()), last_task_count(0),
+      last_wait_ns(0), last_busy_ns(0), grow_streak(0), shrink_streak(0), sampled_wait_us(0), sampled_utilization(0),
+      grow_events(0), shrink_events(0)
+{
+    // 保证 1 <= min <= 初始线程数 <= max
+    policy.min_threads = std::max<size_t>(policy.min_threads, 1);
+    policy.max_threads = std::max(policy.max_threads, policy.min_threads);
+    policy.grow_samples = std::max(policy.grow_samples, 1);
+    policy.shrink_samples = std::max(policy.shrink_samples, 1);
+    thread_count = std::min(std::max(thread_count, policy.min_threads), policy.max_threads);
+
+    // 单核时自旋只会占用提交者需要的CPU
+    spin_count = std::thread::hardware_concurrency() > 1 ? SPIN_COUNT : 0;
+
+    max_workers = policy.max_threads;
+    states.reset(new WorkerState[max_workers]);
+    for (size_t i = 0; i < max_workers; ++i)
+    {
+        states[i].wakeup_fd = eventfd(0, EFD_CLOEXEC);
+        if (states[i].wakeup_fd == -1)
+        {
+            while (i > 0)
+                close(states[--i].wakeup_fd);
+            throw std::runtime_error("创建线程池eventfd失败");
+        }
+    }
+
+    workers.resize(max_workers);
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    startWorkers(thread_count);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+    for (size_t i = 0; i < max_workers; ++i)
+    {
+        close(states[i].wakeup_fd);
+    }
+}
+
+size_t ThreadPool::startWorkers(size_t count)
+{
+    size_t started = 0;
+    for (size_t i = 0; i < max_workers && started < count; ++i)
+    {
+        WorkerState &state = states[i];
+        if (workers[i].joinable())
+        {
+            // 运行中或正在退出的线程占用该槽位
+            if (!state.exited.load(std::memory_order_acquire))
+                continue;
+            workers[i].join();
+        }
+
+        state.retiring.store(false, std::memory_order_relaxed);
+        state.exited.store(false, std::memory_order_relaxed);
+        if (slot_count.load(std::memory_order_relaxed) < i + 1)
+            slot_count.store(i + 1, std::memory_order_release);
+        live_workers.fetch_add(1, std::memory_order_relaxed);
+        workers[i] = std::thread(&ThreadPool::workerLoop, this, i);
+        ++started;
+    }
+    return started;
+}
+
+bool ThreadPool::retireWorker()
+{
+    for (size_t i = max_workers; i > 0; --i)
+    {
+        WorkerState &state = states[i - 1];
+        if (!workers[i - 1].joinable() || state.retiring.load(std::memory_order_relaxed))
+            continue;
+
+        // 与waitForTask中的屏障配对: 线程要么在休眠前看到退出标志, 要么已标记休眠而由这里唤醒
+        state.retiring.store(true);
+        live_workers.fetch_sub(1, std::memory_order_relaxed);
+        if (state.parked.load() && state.parked.exchange(false))
+        {
+            idle_workers.fetch_sub(1, std::memory_order_relaxed);
+            uint64_t one = 1;
+            ssize_t n = write(state.wakeup_fd, &one, sizeof(one));
+            (void)n;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::tryPost(Task task)
+{
+    if (stopping.load(std::memory_order_relaxed))
+        return false;
+
+    Job *item = new Job{std::move(task), Clock::now()};
+    bool local = current_pool == this && states[current_index].local.push(item);
+    if (!local && !injection.tryPush(std::move(item)))
+    {
+        delete item;
+        rejected_tasks.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // 与waitForTask中的屏障配对, 只有确实有线程休眠时才需要系统调用
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_workers.load(std::memory_order_relaxed) > 0)
+    {
+        wakeOne();
+    }
+    return true;
+}
+
+bool ThreadPool::wakeOne()
+{
+    size_t count = slot_count.load(std::memory_order_acquire);
+    size_t start = next_sleeper.fetch_add(1, std::memory_order_relaxed);
+    for (size_t k = 0; k < count; ++k)
+    {
+        WorkerState &state = states[(start + k) % count];
+        if (state.parked.load(std::memory_order_relaxed) && state.parked.exchange(false))
+        {
+            idle_workers.fetch_sub(1, std::memory_order_relaxed);
+            uint64_t one = 1;
+            ssize_t n = write(state.wakeup_fd, &one, sizeof(one));
+            (void)n;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::stop()
+{
+    if (stopping.exchange(true))
+        return;
+
+    // 唤醒所有休眠的线程, 它们看到停止标志后退出
+    while (wakeOne())
+    {
+    }
+
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    for (auto &worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+    live_workers.store(0, std::memory_order_relaxed);
+
+    // 丢弃尚未开始的任务
+    Job *job;
+    while (injection.tryPop(job))
+    {
+        delete job;
+    }
+    for (size_t i = 0; i < max_workers; ++i)
+    {
+        while ((job = states[i].local.pop()) != nullptr)
+            delete job;
+    }
+}
+
+void ThreadPool::adjust()
+{
+    std::lock_guard<std::mutex> lock(resize_mutex);
+    if (stopping.load(std::memory_order_relaxed))
+        return;
+
+    // 汇总所有槽位的累计值(包括已退出的线程), 与上次采样相减得到本周期的增量
+    uint64_t tasks = 0;
+    uint64_t wait_ns = 0;
+    uint64_t busy_ns = 0;
+    size_t slots = slot_count.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < slots; ++i)
+    {
+        tasks += states[i].task_count.load(std::memory_order_relaxed);
+        wait_ns += states[i].wait_ns.load(std::memory_order_relaxed);
+        busy_ns += states[i].busy_ns.load(std::memory_order_relaxed);
+    }
+
+    Clock::time_point now = Clock::now();
+    int64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_sample_time).count();
+    uint64_t period_tasks = tasks - last_task_count;
+    uint64_t period_wait_ns = wait_ns - last_wait_ns;
+    uint64_t period_busy_ns = busy_ns - last_busy_ns;
+    last_sample_time = now;
+    last_task_count = tasks;
+    last_wait_ns = wait_ns;
+    last_busy_ns = busy_ns;
+    if (elapsed_ns <= 0)
+        return;
+
+    // 利用率: 本周期完成任务的执行时间占全部线程时间的比例; 长任务完成前不计入, 因此同时参考正在执行的任务数
+    size_t live = live_workers.load(std::memory_order_relaxed);
+    size_t active = static_cast<size_t>(std::max(active_tasks.load(std::memory_order_relaxed), 0));
+    size_t queued = queueSize();
+    double utilization = static_cast<double>(period_busy_ns) / (static_cast<double>(elapsed_ns) * live);
+    utilization = std::min(std::max(utilization, static_cast<double>(active) / live), 1.0);
+    int64_t wait_us = period_tasks > 0 ? static_cast<int64_t>(period_wait_ns / period_tasks / 1000) : 0;
+    sampled_wait_us.store(wait_us, std::memory_order_relaxed);
+    sampled_utilization.store(static_cast<int>(utilization * 100 + 0.5), std::memory_order_relaxed);
+
+    if (policy.min_threads == policy.max_threads)
+        return;
+
+    // 排队过久, 或者所有线程都忙且有任务积压但本周期没有任务完成(只有长任务), 需要扩容
+    bool overloaded = wait_us > policy.grow_wait_us || (period_tasks == 0 && queued > 0 && active >= live);
+    // 扩容和缩容的阈值之间留有间隔: 平均排队时间不超过扩容阈值的1/4才考虑缩容
+    bool underloaded = !overloaded && queued == 0 && utilization < policy.shrink_utilization &&
+                       wait_us * 4 <= policy.grow_wait_us;
+    grow_streak = overloaded ? grow_streak + 1 : 0;
+    shrink_streak = underloaded ? shrink_streak + 1 : 0;
+
+    if (grow_streak >= policy.grow_samples && live < policy.max_threads)
+    {
+        // 突发负载下尽快追上: 每次增加当前线程数的一半
+        size_t target = std::min(live + std::max<size_t>(live / 2, 1), policy.max_threads);
+        size_t started = startWorkers(target - live);
+        if (started > 0)
+        {
+            grow_events.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "工作线程池扩容: " << live << " -> " << live + started << " (平均排队 " << wait_us
+                      << "us, 利用率 " << static_cast<int>(utilization * 100) << "%)" << '\n';
+        }
+        grow_streak = 0;
+        shrink_streak = 0;
+    }
+    else if (shrink_streak >= policy.shrink_samples && live > policy.min_threads)
+    {
+        // 缩容每次只退出一个线程, 负载回升时不至于一下子失去太多线程
+        if (retireWorker())
+        {
+            shrink_events.fetch_add(1, std::memory_order_relaxed);
+            std::cout << "工作线程池缩容: " << live << " -> " << live - 1 << " (平均排队 " << wait_us
+                      << "us, 利用率 " << static_cast<int>(utilization * 100) << "%)" << '\n';
+        }
+        grow_streak = 0;
+        shrink_streak = 0;
+    }
+}
+
+size_t ThreadPool::queueSize() const
+{
+    size_t size = injection.sizeApprox();
+    size_t slots = slot_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < slots; ++i)
+    {
+        size += states[i].local.sizeApprox();
+    }
+    return size;
+}
+
+bool ThreadPool::hasPendingTasks() const
+{
+    if (!injection.emptyApprox())
+        return true;
+    size_t slots = slot_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < slots; ++i)
+    {
+        if (!states[i].local.emptyApprox())
+            return true;
+    }
+    return false;
+}
+
+ThreadPool::Job *ThreadPool::takeFromInjection(size_t index, std::vector<Job *> &batch)
+{
+    WorkStealingDeque<Job> &local = states[index].local;
+
+    // 按排队长度均分给所有线程, 避免一个线程取走大量任务而其他线程空闲; 同时不能超过本地队列的剩余空间
+    size_t live = std::max<size_t>(live_workers.load(std::memory_order_relaxed), 1);
+    size_t limit = std::min(injection.sizeApprox() / live + 1, MAX_BATCH);
+    limit = std::min(limit, local.capacity() - local.sizeApprox());
+    size_t count = injection.popBatch(batch.data(), limit);
+    if (count == 0)
+        return nullptr;
+
+    // 其余任务倒序压入: 本线程从底部按提交顺序执行, 窃取者从顶部拿走排在最后的任务
+    for (size_t i = count - 1; i > 0; --i)
+    {
+        local.push(batch[i]);
+    }
+
+    // 本地队列中有了可窃取的任务, 让一个休眠的线程来分担
+    if (count > 1)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle_workers.load(std::memory_order_relaxed) > 0)
+            wakeOne();
+    }
+    return batch[0];
+}
+
+ThreadPool::Job *ThreadPool::stealTask(size_t index, unsigned seed)
+{
+    // 从不同的位置开始依次尝试其他线程, 避免所有窃取者同时争抢同一个线程
+    size_t slots = slot_count.load(std::memory_order_acquire);
+    for (size_t k = 0; k + 1 < slots; ++k)
+    {
+        size_t victim = (index + 1 + (seed + k) % (slots - 1)) % slots;
+        Job *job = states[victim].local.steal();
+        if (job != nullptr)
+            return job;
+    }
+    return nullptr;
+}
+
+void ThreadPool::runTask(Job *job, WorkerState &self)
+{
+    Clock::time_point start = Clock::now();
+    Clock::time_point queued_at = job->queued_at;
+    active_tasks.fetch_add(1, std::memory_order_relaxed);
+    try
+    {
+        job->fn();
+    }
+    catch (const std::exception &e)
+    {
+        // 任务自身应处理异常, 这里只防止工作线程因异常退出
+        std::cerr << "工作线程任务异常: " << e.what() << '\n';
+    }
+
+    // 及时释放任务持有的对象(例如连接)
+    delete job;
+    active_tasks.fetch_sub(1, std::memory_order_relaxed);
+    completed_tasks.fetch_add(1, std::memory_order_relaxed);
+
+    // 只有本线程写这些计数, 不需要原子加
+    Clock::time_point end = Clock::now();
+    uint64_t wait = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(start - queued_at).count());
+    uint64_t busy = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    self.wait_ns.store(self.wait_ns.load(std::memory_order_relaxed) + wait, std::memory_order_relaxed);
+    self.busy_ns.store(self.busy_ns.load(std::memory_order_relaxed) + busy, std::memory_order_relaxed);
+    self.task_count.store(self.task_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void ThreadPool::waitForTask(size_t index)
+{
+    WorkerState &self = states[index];
+    for (int i = 0; i < spin_count; ++i)
+    {
+        if (hasPendingTasks() || stopping.load(std::memory_order_relaxed))
+            return;
+        cpuRelax();
+    }
+
+    self.parked.store(true, std::memory_order_relaxed);
+    idle_workers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // 标记休眠之后再检查一次; 如果能自己清除标记就不必休眠, 否则唤醒者已经或即将写eventfd
+    if (hasPendingTasks() || stopping.load(std::memory_order_relaxed) || self.retiring.load(std::memory_order_relaxed))
+    {
+        if (self.parked.exchange(false))
+        {
+            idle_workers.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    uint64_t value;
+    while (read(self.wakeup_fd, &value, sizeof(value)) == -1 && errno == EINTR)
+    {
+    }
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    current_pool = this;
+    current_index = index;
+
+    WorkerState &self = states[index];
+    WorkStealingDeque<Job> &local = self.local;
+    std::vector<Job *> batch(MAX_BATCH);
+    unsigned ticks = 0;
+
+    while (!stopping.load(std::memory_order_relaxed) && !self.retiring.load(std::memory_order_relaxed))
+    {
+        ++ticks;
+        Job *task = nullptr;
+        if (ticks % INJECTION_CHECK_INTERVAL == 0)
+            task = takeFromInjection(index, batch);
+        if (task == nullptr)
+            task = local.pop();
+        if (task == nullptr)
+            task = takeFromInjection(index, batch);
+        if (task == nullptr)
+            task = stealTask(index, ticks);
+
+        if (task == nullptr)
+        {
+            waitForTask(index);
+            continue;
+        }
+        runTask(task, self);
+    }
+
+    // 缩容退出: 其他线程不会再向本地队列放入任务, 执行完剩余的任务再退出
+    if (self.retiring.load(std::memory_order_relaxed) && !stopping.load(std::memory_order_relaxed))
+    {
+        Job *task;
+        while ((task = local.pop()) != nullptr)
+        {
+            runTask(task, self);
+        }
+
+        // 休眠时被提交者认领的唤醒不能丢失, 有排队的任务时转交给另一个休眠的线程
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (hasPendingTasks() && idle_workers.load(std::memory_order_relaxed) > 0)
+            wakeOne();
+    }
+
+    current_pool = nullptr;
+    self.exited.store(true, std::memory_order_release);
+}
\ No newline at end of file
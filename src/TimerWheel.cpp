@@ -0,0 +1,131 @@
+/*
+ * @Author: No_World 2259881867@qq.com
+ * @Date: 2026-10-17 10:34:09
+ * @LastEditors: No_World 2259881867@qq.com
+ * @LastEditTime: 2026-10-17 10:34:09
+ * @FilePath: /WebServerByCPP/src/TimerWheel.cpp
+ * @Description: 分层时间轮实现, 槽位为定时器id链表, 定时器保存在哈希表中, 取消时通过保存的迭代器直接摘除
+ */
+#include "../include/TimerWheel.h"
+#include <utility>
+#include <vector>
+
+TimerWheel::TimerWheel() : timers(), current_tick(0), next_id(0)
+{
+}
+
+void TimerWheel::place(TimerId id, Timer &timer)
+{
+    const uint64_t expire = timer.expire_tick;
+    const uint64_t delta = expire - current_tick;
+
+    Slot *slot;
+    if (delta < ROOT_SIZE)
+    {
+        slot = &root[expire & (ROOT_SIZE - 1)];
+    }
+    else
+    {
+        // 找到能容纳delta的最低层
+        int level = 0;
+        while (level < LEVELS - 2 && delta >= (1ULL << (ROOT_BITS + (level + 1) * LEVEL_BITS)))
+            ++level;
+        uint64_t index = (expire >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+        slot = &levels[level][index];
+    }
+
+    timer.slot = slot;
+    timer.position = slot->insert(slot->end(), id);
+}
+
+TimerWheel::TimerId TimerWheel::add(uint64_t ticks, Callback callback)
+{
+    // 当前tick的槽位可能正在处理, 至少推迟到下一个tick
+    if (ticks < 1)
+        ticks = 1;
+    if (ticks >= MAX_TICKS)
+        ticks = MAX_TICKS - 1;
+
+    TimerId id = ++next_id;
+    Timer &timer = timers[id];
+    timer.expire_tick = current_tick + ticks;
+    timer.callback = std::move(callback);
+    place(id, timer);
+    return id;
+}
+
+void TimerWheel::cancel(TimerId id)
+{
+    auto it = timers.find(id);
+    if (it == timers.end())
+        return;
+
+    it->second.slot->erase(it->second.position);
+    timers.erase(it);
+}
+
+uint64_t TimerWheel::cascade(int level, uint64_t index)
+{
+    Slot pending;
+    pending.swap(levels[level - 1][index]);
+
+    for (TimerId id : pending)
+    {
+        place(id, timers[id]);
+    }
+    return index;
+}
+
+void TimerWheel::advanceTo(uint64_t tick)
+{
+    // 没有定时器时直接跳到目标tick, 长时间空闲后不必逐个空转
+    if (timers.empty())
+    {
+        if (tick > current_tick)
+            current_tick = tick;
+        return;
+    }
+
+    std::vector<Callback> expired;
+
+    while (current_tick < tick)
+    {
+        if (timers.empty())
+        {
+            current_tick = tick;
+            break;
+        }
+        ++current_tick;
+
+        // 第0层转满一圈时, 把上一层对应槽位中的定时器下放; 逐层向上同理
+        const uint64_t index = current_tick & (ROOT_SIZE - 1);
+        if (index == 0)
+        {
+            for (int level = 1; level < LEVELS; ++level)
+            {
+                uint64_t level_index = (current_tick >> (ROOT_BITS + (level - 1) * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+                if (cascade(level, level_index) != 0)
+                    break;
+            }
+        }
+
+        // 先摘除当前槽位的全部定时器, 回调执行时再添加或取消定时器都不会影响本次处理
+        Slot due;
+        due.swap(root[index]);
+        for (TimerId id : due)
+        {
+            auto it = timers.find(id);
+            expired.push_back(std::move(it->second.callback));
+            timers.erase(it);
+        }
+
+        if (!expired.empty())
+        {
+            for (const Callback &callback : expired)
+            {
+                callback();
+            }
+            expired.clear();
+        }
+    }
+}
\ No newline at end of file
@@ -7,10 +7,14 @@
  * @Description: HTTP服务器程序入口点，负责服务器初始化、实例创建和信号处理
  * 实现了优雅的启动与关闭机制，通过信号处理（如SIGINT）支持用户中断操作
  * 采用异常处理确保在发生错误时能够正确清理资源
+ * 创建服务器之前先启动CGI辅助进程, 之后的CGI请求不再fork整个服务器进程
+ * 配置worker_processes大于0时以多进程模式运行: 主进程创建监听socket并管理工作进程, 每个工作进程运行一个HttpServer
  * 作为C++重构版HTTP服务器的驱动程序，展示了现代C++的错误处理和资源管理方法
  */
+#include "../include/CgiSpawner.h"
 #include "../include/ConfigManager.h"
 #include "../include/HttpServer.h"
+#include "../include/MasterProcess.h"
 #include <csignal>
 #include <iostream>
 
@@ -27,6 +31,32 @@ void signalHandler(int signal)
     }
 }
 
+// 创建并运行服务器, listen_socket为-1时由服务器自己创建监听socket
+int runServer(unsigned short port, int listen_socket)
+{
+    // CGI辅助进程要在服务器创建线程之前fork, 此时进程的地址空间还很小
+    if (ConfigManager::getBool("cgi_spawner", true))
+    {
+        CgiSpawner::start(ConfigManager::getInt("cgi_spawner_warm", 2));
+    }
+
+    HttpServer server(port); // 创建server对象，设置默认端口6379
+    if (listen_socket != -1)
+    {
+        server.setListenSocket(listen_socket);
+    }
+    g_server = &server;
+
+    // 注册信号处理
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    std::cout << "HTTP服务器启动中..." << std::endl;
+    server.start(); // 这会阻塞直到服务器停止
+    g_server = nullptr;
+    return 0;
+}
+
 int main()
 {
     try
@@ -34,15 +64,19 @@ int main()
         // 创建服务器
         ConfigManager::loadConfig("config/server.conf");
         unsigned short port = ConfigManager::getInt("port", 6379);
-        HttpServer server(port); // 创建server对象，设置默认端口6379
-        g_server = &server;
 
-        // 注册信号处理
-        std::signal(SIGINT, signalHandler);
+        // 对端关闭后继续写socket/管道时不终止进程, 由write返回的EPIPE处理
+        std::signal(SIGPIPE, SIG_IGN);
+
+        // 多进程模式: 工作进程共享主进程创建的监听socket
+        int worker_processes = ConfigManager::getInt("worker_processes", 0);
+        if (worker_processes > 0)
+        {
+            MasterProcess master(port, worker_processes, ConfigManager::getInt("listen_backlog", SOMAXCONN));
+            return master.run([port](int listen_socket) { return runServer(port, listen_socket); });
+        }
 
-        std::cout << "HTTP服务器启动中..." << std::endl;
-        server.start(); // 这会阻塞直到服务器停止
-        return 0;
+        return runServer(port, -1);
     }
     catch (const std::exception &e)
     {